@@ -2,53 +2,731 @@
 #include <Python.h>
 #include <structmember.h>
 #include <stddef.h>  /* for offsetof */
+#include <string.h>  /* for memcpy */
+
+#if defined(__linux__)
+#include <sys/mman.h>  /* for mmap, mremap, munmap and madvise */
+#include <stdint.h>    /* for uintptr_t */
+#define ARRAYDEQUE_HAVE_MREMAP 1
+#endif
+
+/* Pointer scans compare several slots per instruction where the compiler
+   targets SSE2 (all x86-64) or AVX2 (e.g. with CFLAGS=-mavx2). */
+#if SIZEOF_VOID_P == 8 && defined(__AVX2__)
+#include <immintrin.h>
+#define ARRAYDEQUE_HAVE_AVX2 1
+#elif SIZEOF_VOID_P == 8 && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define ARRAYDEQUE_HAVE_SSE2 1
+#endif
 
 #ifndef ARRAYDEQUE_VERSION
 #define ARRAYDEQUE_VERSION "1.4.0"
 #endif
 
-/* The ArrayDeque object structure. */
+/* Initial capacity of the backing array (must be a power of two). */
+#define ARRAYDEQUE_MIN_CAPACITY 8
+
+/* Number of slots embedded in each object; arrays of this capacity or less
+   need no separate allocation. */
+#define ARRAYDEQUE_INLINE_CAPACITY ARRAYDEQUE_MIN_CAPACITY
+
+/* Default occupancy below which the backing array is halved. */
+#define ARRAYDEQUE_SHRINK_THRESHOLD 0.25
+
+/* Backing arrays of at least this many bytes are mapped directly from the
+   kernel (where mremap is available) so that growing them moves page table
+   entries instead of copying every pointer. */
+#define ARRAYDEQUE_MMAP_THRESHOLD ((size_t)1 << 21)
+
+/* Alignment of mapped arrays that ask for transparent huge pages. */
+#define ARRAYDEQUE_HUGEPAGE_SIZE ((size_t)1 << 21)
+
+/* Maximum number of deques, small arrays and iterators kept for reuse.
+   The freelists live in the module state, so each interpreter has its own,
+   but they rely on the GIL, so free-threaded builds go without them. */
+#ifdef Py_GIL_DISABLED
+#define ARRAYDEQUE_MAXFREELIST 0
+#else
+#define ARRAYDEQUE_MAXFREELIST 80
+#endif
+
+/* Capacity of the heap arrays kept on the freelist: the first size that
+   no longer fits in the inline slots. */
+#define ARRAYDEQUE_FREELIST_ARRAY_CAPACITY (2 * ARRAYDEQUE_INLINE_CAPACITY)
+
+/* Items moved from the old to the new array by each append or pop while an
+   incremental resize is in progress.  Any value of at least one finishes the
+   migration before the new array fills up. */
+#define ARRAYDEQUE_MIGRATE_STEP 4
+
+/* Slots searched for an identical pointer at a time before the items in
+   front of it are compared by value, so that they are still in cache. */
+#define ARRAYDEQUE_SCAN_BLOCK 256
+
+/* The ArrayDeque object structure.
+   The backing array is a ring buffer whose capacity is always a power of two,
+   so the item at logical index i lives at array[(head + i) & (capacity - 1)].
+   In incremental mode, a full array is replaced by one twice as large without
+   copying; until the migration finishes, the items at logical indices
+   [migrate_lo, migrate_hi) still live at old_array[(head + i) &
+   (old_capacity - 1)], which is where they were before the switch. */
 typedef struct {
     PyObject_HEAD
     PyObject **array;        /* pointer to array of PyObject* */
-    Py_ssize_t capacity;     /* allocated length of array */
+    Py_ssize_t capacity;     /* allocated length of array (power of two) */
     Py_ssize_t size;         /* number of elements stored */
     Py_ssize_t head;         /* index of first element */
-    Py_ssize_t tail;         /* index one past the last element */
     Py_ssize_t maxlen;       /* maximum allowed size (if < 0 then unbounded) */
+    Py_ssize_t min_capacity; /* reserved capacity that is never given back */
+    Py_ssize_t shrink_limit; /* shrink the array when size drops below this */
+    double shrink_threshold; /* occupancy ratio that triggers a shrink */
+    int hugepages;           /* back mapped arrays with transparent huge pages */
+    int incremental;         /* grow by migrating a few items per operation */
+    PyObject **old_array;    /* array being migrated from, or NULL */
+    Py_ssize_t old_capacity; /* allocated length of old_array */
+    Py_ssize_t migrate_lo;   /* first logical index still in old_array */
+    Py_ssize_t migrate_hi;   /* one past the last logical index in old_array */
+    size_t state;            /* changed whenever items are added, removed or
+                                moved, so iterators can detect it */
+    PyObject *inline_array[ARRAYDEQUE_INLINE_CAPACITY]; /* storage for small deques */
 } ArrayDequeObject;
 
+/* Per-module state, defined below */
+typedef struct ArrayDequeState ArrayDequeState;
+
 /* Forward declaration of type for iterator */
 typedef struct {
     PyObject_HEAD
     ArrayDequeObject *deque; /* reference to the deque */
-    Py_ssize_t index;        /* current index into the deque (0 .. size) */
+    Py_ssize_t index;        /* next index into the deque: counts up from 0,
+                                or down from size - 1 when reversed */
+    size_t state;            /* state of the deque when iteration started */
+    ArrayDequeState *module_state; /* module state that owns the freelist */
 } ArrayDequeIter;
 
-/* Resize the backing array to new_capacity and recenter the data.
+/* Type flags: ArrayDeque and its iterators are heap types, which are
+   mutable unless marked immutable (from Python 3.10), and the iterators
+   can only be created by ArrayDeque. */
+#ifdef Py_TPFLAGS_IMMUTABLETYPE
+#define ARRAYDEQUE_TPFLAGS_IMMUTABLE Py_TPFLAGS_IMMUTABLETYPE
+#else
+#define ARRAYDEQUE_TPFLAGS_IMMUTABLE 0
+#endif
+#ifdef Py_TPFLAGS_DISALLOW_INSTANTIATION
+#define ARRAYDEQUE_TPFLAGS_ITER \
+    (ARRAYDEQUE_TPFLAGS_IMMUTABLE | Py_TPFLAGS_DISALLOW_INSTANTIATION)
+#else
+#define ARRAYDEQUE_TPFLAGS_ITER ARRAYDEQUE_TPFLAGS_IMMUTABLE
+#endif
+
+/* Per-module state: the types, which are heap types created for each
+   module object, and the freelists. */
+struct ArrayDequeState {
+    PyTypeObject *deque_type;
+    PyTypeObject *iter_type;
+    PyTypeObject *reviter_type;
+#if ARRAYDEQUE_MAXFREELIST > 0
+    /* Freelists of dead exact ArrayDeque instances, of backing arrays with
+       ARRAYDEQUE_FREELIST_ARRAY_CAPACITY slots and of iterators.  Creating
+       and discarding short-lived deques then skips the allocator entirely. */
+    ArrayDequeObject *deque_freelist[ARRAYDEQUE_MAXFREELIST];
+    int deque_numfree;
+    PyObject **array_freelist[ARRAYDEQUE_MAXFREELIST];
+    int array_numfree;
+    ArrayDequeIter *iter_freelist[ARRAYDEQUE_MAXFREELIST];
+    int iter_numfree;
+#endif
+};
+
+static PyObject *ArrayDeque_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+static void ArrayDeque_dealloc(ArrayDequeObject *self);
+static void ArrayDequeIter_dealloc(ArrayDequeIter *it);
+static PyObject *ArrayDeque_iter(ArrayDequeObject *self);
+
+/* Return the state of the module that defined type, which is ArrayDeque, a
+   subclass of it or one of the iterator types.  Subclasses share the layout
+   of ArrayDeque, so it is on their base chain; the types of this module are
+   recognized by their deallocators, which is cheaper than
+   PyType_GetModuleByDef and works before Python 3.11. */
+static inline ArrayDequeState *
+arraydeque_state_of(PyTypeObject *type)
+{
+    while (type->tp_dealloc != (destructor)ArrayDeque_dealloc &&
+           type->tp_dealloc != (destructor)ArrayDequeIter_dealloc)
+        type = type->tp_base;
+    return (ArrayDequeState *)PyType_GetModuleState(type);
+}
+
+/* Return whether obj is an ArrayDeque or an instance of a subclass, from any
+   module object.  They share the layout, so ArrayDeque is on the base chain
+   of their type, and it is recognized by its deallocator. */
+static inline int
+arraydeque_check(PyObject *obj)
+{
+    for (PyTypeObject *type = Py_TYPE(obj); type != NULL; type = type->tp_base) {
+        if (type->tp_dealloc == (destructor)ArrayDeque_dealloc)
+            return 1;
+    }
+    return 0;
+}
+
+/* Return whether self is an ArrayDeque rather than a subclass instance. */
+static inline int
+arraydeque_check_exact(ArrayDequeObject *self)
+{
+    return Py_TYPE(self) == arraydeque_state_of(Py_TYPE(self))->deque_type;
+}
+
+/* Release the memory held by the freelists. */
+static void
+arraydeque_clear_freelists(ArrayDequeState *state)
+{
+#if ARRAYDEQUE_MAXFREELIST > 0
+    while (state->deque_numfree > 0)
+        PyObject_Free(state->deque_freelist[--state->deque_numfree]);
+    while (state->array_numfree > 0)
+        PyMem_Free(state->array_freelist[--state->array_numfree]);
+    while (state->iter_numfree > 0)
+        PyObject_Free(state->iter_freelist[--state->iter_numfree]);
+#endif
+}
+
+/* Return the position in the backing array of the item at logical index i. */
+static inline Py_ssize_t
+arraydeque_pos(ArrayDequeObject *self, Py_ssize_t i)
+{
+    return (self->head + i) & (self->capacity - 1);
+}
+
+/* Return a pointer to the slot holding the item at logical index i,
+   following an unfinished incremental migration if there is one. */
+static inline PyObject **
+arraydeque_slot(ArrayDequeObject *self, Py_ssize_t i)
+{
+    if (i < self->migrate_hi && i >= self->migrate_lo)
+        return &self->old_array[(self->head + i) & (self->old_capacity - 1)];
+    return &self->array[arraydeque_pos(self, i)];
+}
+
+/* How a backing array of a given capacity is stored. */
+enum {
+    ARRAYDEQUE_STORAGE_INLINE,  /* the slots embedded in the object */
+    ARRAYDEQUE_STORAGE_HEAP,    /* allocated with PyMem_Malloc */
+    ARRAYDEQUE_STORAGE_MAPPED,  /* mapped with mmap */
+};
+
+/* Return the storage used for a backing array of the given capacity.
+   The choice depends only on the capacity, so it never needs recording. */
+static inline int
+arraydeque_storage(Py_ssize_t capacity)
+{
+    if (capacity <= ARRAYDEQUE_INLINE_CAPACITY)
+        return ARRAYDEQUE_STORAGE_INLINE;
+#ifdef ARRAYDEQUE_HAVE_MREMAP
+    if ((size_t)capacity * sizeof(PyObject *) >= ARRAYDEQUE_MMAP_THRESHOLD)
+        return ARRAYDEQUE_STORAGE_MAPPED;
+#endif
+    return ARRAYDEQUE_STORAGE_HEAP;
+}
+
+#ifdef ARRAYDEQUE_HAVE_MREMAP
+/* Map size bytes (a multiple of the huge page size) at a huge page boundary
+   and ask the kernel to back them with transparent huge pages, which cuts
+   TLB misses for random access and scans over large arrays.
+   Returns MAP_FAILED on failure. */
+static void *
+arraydeque_map_hugepages(size_t size)
+{
+    size_t span = size + ARRAYDEQUE_HUGEPAGE_SIZE;
+    char *base, *aligned;
+
+    base = mmap(NULL, span, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return MAP_FAILED;
+    /* Trim the unaligned slack on both sides of the aligned range */
+    aligned = (char *)(((uintptr_t)base + ARRAYDEQUE_HUGEPAGE_SIZE - 1) &
+                       ~(uintptr_t)(ARRAYDEQUE_HUGEPAGE_SIZE - 1));
+    if (aligned > base)
+        munmap(base, aligned - base);
+    if (aligned + size < base + span)
+        munmap(aligned + size, base + span - (aligned + size));
+#ifdef MADV_HUGEPAGE
+    /* Only a hint: without THP support the mapping still works */
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+#endif
+
+/* Return an uninitialized backing array of capacity slots for self.  Small
+   arrays use the slots embedded in the object, and mapped arrays are aligned
+   for transparent huge pages when self->hugepages is set.
+   Returns NULL with MemoryError set on failure. */
+static PyObject **
+arraydeque_array_alloc(ArrayDequeObject *self, Py_ssize_t capacity)
+{
+    PyObject **array;
+
+    switch (arraydeque_storage(capacity)) {
+    case ARRAYDEQUE_STORAGE_INLINE:
+        return self->inline_array;
+#ifdef ARRAYDEQUE_HAVE_MREMAP
+    case ARRAYDEQUE_STORAGE_MAPPED: {
+        size_t size = (size_t)capacity * sizeof(PyObject *);
+        if ((size_t)capacity > PY_SSIZE_T_MAX / sizeof(PyObject *)) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        if (self->hugepages)
+            array = arraydeque_map_hugepages(size);
+        else
+            array = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (array == MAP_FAILED) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        return array;
+    }
+#endif
+    default:
+#if ARRAYDEQUE_MAXFREELIST > 0
+        if (capacity == ARRAYDEQUE_FREELIST_ARRAY_CAPACITY) {
+            ArrayDequeState *state = arraydeque_state_of(Py_TYPE(self));
+            if (state->array_numfree > 0)
+                return state->array_freelist[--state->array_numfree];
+        }
+#endif
+        array = PyMem_New(PyObject *, capacity);
+        if (array == NULL)
+            PyErr_NoMemory();
+        return array;
+    }
+}
+
+/* Release a backing array of capacity slots obtained from
+   arraydeque_array_alloc for self. */
+static void
+arraydeque_array_free(ArrayDequeObject *self, PyObject **array,
+                      Py_ssize_t capacity)
+{
+    switch (arraydeque_storage(capacity)) {
+    case ARRAYDEQUE_STORAGE_INLINE:
+        return;
+#ifdef ARRAYDEQUE_HAVE_MREMAP
+    case ARRAYDEQUE_STORAGE_MAPPED:
+        munmap(array, (size_t)capacity * sizeof(PyObject *));
+        return;
+#endif
+    default:
+#if ARRAYDEQUE_MAXFREELIST > 0
+        if (capacity == ARRAYDEQUE_FREELIST_ARRAY_CAPACITY) {
+            ArrayDequeState *state = arraydeque_state_of(Py_TYPE(self));
+            if (state->array_numfree < ARRAYDEQUE_MAXFREELIST) {
+                state->array_freelist[state->array_numfree++] = array;
+                return;
+            }
+        }
+#endif
+        PyMem_Free(array);
+    }
+}
+
+/* Resize the backing array of self to new_capacity slots, preserving the
+   first min(capacity, new_capacity) slots at their positions.  Mapped arrays
+   are grown with mremap, which lets the kernel move the pages without a
+   userspace copy, and heap arrays with PyMem_Realloc.  With hugepages, mapped
+   arrays are moved onto a fresh huge page aligned range so that they stay
+   aligned.  The caller installs the returned array.
+   Returns NULL with MemoryError set on failure, leaving the array intact. */
+static PyObject **
+arraydeque_array_realloc(ArrayDequeObject *self, Py_ssize_t new_capacity)
+{
+    PyObject **new_array;
+    Py_ssize_t old_capacity = self->capacity;
+    int storage = arraydeque_storage(old_capacity);
+
+    if ((size_t)new_capacity > PY_SSIZE_T_MAX / sizeof(PyObject *)) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    if (storage == arraydeque_storage(new_capacity)) {
+        assert(storage != ARRAYDEQUE_STORAGE_INLINE);
+#ifdef ARRAYDEQUE_HAVE_MREMAP
+        if (storage == ARRAYDEQUE_STORAGE_MAPPED) {
+            size_t old_size = (size_t)old_capacity * sizeof(PyObject *);
+            size_t new_size = (size_t)new_capacity * sizeof(PyObject *);
+            if (self->hugepages) {
+                void *target = arraydeque_map_hugepages(new_size);
+                if (target == MAP_FAILED) {
+                    PyErr_NoMemory();
+                    return NULL;
+                }
+                new_array = mremap(self->array, old_size, new_size,
+                                   MREMAP_MAYMOVE | MREMAP_FIXED, target);
+                if (new_array == MAP_FAILED)
+                    munmap(target, new_size);
+            }
+            else {
+                new_array = mremap(self->array, old_size, new_size,
+                                   MREMAP_MAYMOVE);
+            }
+            if (new_array == MAP_FAILED) {
+                PyErr_NoMemory();
+                return NULL;
+            }
+            return new_array;
+        }
+#endif
+        new_array = PyMem_Realloc(self->array,
+                                  (size_t)new_capacity * sizeof(PyObject *));
+        if (new_array == NULL)
+            PyErr_NoMemory();
+        return new_array;
+    }
+    /* Changing the kind of storage means copying once */
+    new_array = arraydeque_array_alloc(self, new_capacity);
+    if (new_array == NULL)
+        return NULL;
+    memcpy(new_array, self->array,
+           (size_t)Py_MIN(old_capacity, new_capacity) * sizeof(PyObject *));
+    arraydeque_array_free(self, self->array, old_capacity);
+    return new_array;
+}
+
+/* Return the smallest power of two that is at least n and at least the
+   minimum capacity, or -1 if such an array could not be addressed. */
+static Py_ssize_t
+arraydeque_round_capacity(Py_ssize_t n)
+{
+    Py_ssize_t capacity = ARRAYDEQUE_MIN_CAPACITY;
+    while (capacity < n) {
+        if (capacity > PY_SSIZE_T_MAX / 2 / (Py_ssize_t)sizeof(PyObject *))
+            return -1;
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/* Recompute the size below which the backing array is shrunk.
+   Arrays at or below the reserved capacity are never shrunk, and neither are
+   the arrays of incremental deques, since a shrink copies every item in one
+   go and pops would lose their bounded latency. */
+static void
+arraydeque_update_shrink_limit(ArrayDequeObject *self)
+{
+    if (self->capacity > self->min_capacity && !self->incremental)
+        self->shrink_limit = (Py_ssize_t)(self->capacity * self->shrink_threshold);
+    else
+        self->shrink_limit = 0;
+}
+
+/* Move up to n items of an incremental migration into the new array, and
+   release the old array once nothing is left in it. */
+static void
+arraydeque_migrate(ArrayDequeObject *self, Py_ssize_t n)
+{
+    Py_ssize_t stop = Py_MIN(self->migrate_lo + n, self->migrate_hi);
+    Py_ssize_t old_mask = self->old_capacity - 1;
+
+    for (Py_ssize_t i = self->migrate_lo; i < stop; i++) {
+        self->array[arraydeque_pos(self, i)] =
+            self->old_array[(self->head + i) & old_mask];
+    }
+    self->migrate_lo = stop;
+    if (self->migrate_lo >= self->migrate_hi) {
+        arraydeque_array_free(self, self->old_array, self->old_capacity);
+        self->old_array = NULL;
+        self->old_capacity = 0;
+        self->migrate_lo = self->migrate_hi = 0;
+    }
+}
+
+/* Finish any incremental migration, so that every item is in self->array.
+   Operations that move items in bulk call this first. */
+static inline void
+arraydeque_settle(ArrayDequeObject *self)
+{
+    if (self->old_array != NULL)
+        arraydeque_migrate(self, self->migrate_hi - self->migrate_lo);
+}
+
+/* Move the count slots starting at physical position src forward by gap
+   positions around the ring.  The runs may overlap, so the copy starts at the
+   far end and uses memmove on runs that do not wrap.  Only pointers are moved;
+   no reference counts change. */
+static void
+arraydeque_ring_shift_forward(ArrayDequeObject *self, Py_ssize_t src,
+                              Py_ssize_t count, Py_ssize_t gap)
+{
+    Py_ssize_t mask = self->capacity - 1;
+
+    while (count > 0) {
+        Py_ssize_t s = (src + count - 1) & mask;
+        Py_ssize_t d = (s + gap) & mask;
+        Py_ssize_t chunk = Py_MIN(count, Py_MIN(s, d) + 1);
+        memmove(self->array + d - chunk + 1, self->array + s - chunk + 1,
+                chunk * sizeof(PyObject *));
+        count -= chunk;
+    }
+}
+
+/* Move the count slots starting at physical position src backward by gap
+   positions around the ring, starting at the near end. */
+static void
+arraydeque_ring_shift_backward(ArrayDequeObject *self, Py_ssize_t src,
+                               Py_ssize_t count, Py_ssize_t gap)
+{
+    Py_ssize_t mask = self->capacity - 1;
+
+    while (count > 0) {
+        Py_ssize_t s = src & mask;
+        Py_ssize_t d = (s - gap) & mask;
+        Py_ssize_t chunk = Py_MIN(count, self->capacity - Py_MAX(s, d));
+        memmove(self->array + d, self->array + s, chunk * sizeof(PyObject *));
+        src += chunk;
+        count -= chunk;
+    }
+}
+
+/* Copy the pointers of the n items starting at logical index start into
+   dest, without touching reference counts.  No migration may be pending. */
+static void
+arraydeque_copy_out(ArrayDequeObject *self, Py_ssize_t start, Py_ssize_t n,
+                    PyObject **dest)
+{
+    Py_ssize_t pos, first;
+
+    /* An empty list has no item array: memcpy must not be given NULL */
+    if (n == 0)
+        return;
+    pos = arraydeque_pos(self, start);
+    first = Py_MIN(n, self->capacity - pos);
+    memcpy(dest, self->array + pos, first * sizeof(PyObject *));
+    memcpy(dest + first, self->array, (n - first) * sizeof(PyObject *));
+}
+
+/* Store n pointers from src in the slots starting at logical index start,
+   without touching reference counts.  No migration may be pending. */
+static void
+arraydeque_copy_in(ArrayDequeObject *self, Py_ssize_t start,
+                   PyObject *const *src, Py_ssize_t n)
+{
+    Py_ssize_t pos, first;
+
+    /* Deleting a slice passes no items: memcpy must not be given NULL */
+    if (n == 0)
+        return;
+    pos = arraydeque_pos(self, start);
+    first = Py_MIN(n, self->capacity - pos);
+    memcpy(self->array + pos, src, first * sizeof(PyObject *));
+    memcpy(self->array, src + first, (n - first) * sizeof(PyObject *));
+}
+
+/* Move the items into a new backing array of new_capacity slots (a power of
+   two no smaller than size) and unwrap them so the first item is at index 0.
    Returns 0 on success and -1 on failure. */
 static int
 arraydeque_resize(ArrayDequeObject *self, Py_ssize_t new_capacity)
 {
     PyObject **new_array;
-    Py_ssize_t new_head;
-    Py_ssize_t i;
+    Py_ssize_t first;
 
-    new_array = PyMem_New(PyObject *, new_capacity);
-    if (new_array == NULL) {
-        PyErr_NoMemory();
+    arraydeque_settle(self);
+    assert(new_capacity >= self->size);
+    assert((new_capacity & (new_capacity - 1)) == 0);
+    assert(new_capacity != self->capacity);
+    new_array = arraydeque_array_alloc(self, new_capacity);
+    if (new_array == NULL)
+        return -1;
+    /* Copy the run up to the end of the old array, then the wrapped run */
+    first = Py_MIN(self->size, self->capacity - self->head);
+    memcpy(new_array, self->array + self->head, first * sizeof(PyObject *));
+    memcpy(new_array + first, self->array,
+           (self->size - first) * sizeof(PyObject *));
+    arraydeque_array_free(self, self->array, self->capacity);
+    self->array = new_array;
+    self->capacity = new_capacity;
+    self->head = 0;
+    arraydeque_update_shrink_limit(self);
+    return 0;
+}
+
+/* Grow the backing array to new_capacity slots (a larger power of two).
+   The array is grown with arraydeque_array_realloc, which remaps mapped
+   arrays instead of copying them; heap arrays depend on the allocator, which
+   may copy the whole array on platforms that cannot extend it.  Afterwards
+   the shorter of the two wrapped runs, up to half the items, is moved in
+   one go to restore the ring layout.  Callers that cannot afford that stall
+   use incremental mode (see arraydeque_expand) instead.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_grow(ArrayDequeObject *self, Py_ssize_t new_capacity)
+{
+    PyObject **new_array;
+    Py_ssize_t old_capacity = self->capacity;
+    Py_ssize_t front, back;
+
+    arraydeque_settle(self);
+    assert(new_capacity > old_capacity);
+    assert((new_capacity & (new_capacity - 1)) == 0);
+    new_array = arraydeque_array_realloc(self, new_capacity);
+    if (new_array == NULL)
         return -1;
+    self->array = new_array;
+    self->capacity = new_capacity;
+    arraydeque_update_shrink_limit(self);
+
+    /* items from head to the old end, then items wrapped to the start */
+    front = Py_MIN(self->size, old_capacity - self->head);
+    back = self->size - front;
+    if (back == 0)
+        return 0;
+    if (back <= front) {
+        /* Continue the front run past the old end */
+        memcpy(new_array + old_capacity, new_array,
+               back * sizeof(PyObject *));
     }
-    /* Calculate new head so that the existing items are centered */
-    new_head = (new_capacity - self->size) / 2;
-    for (i = 0; i < self->size; i++) {
-        new_array[new_head + i] = self->array[self->head + i];
+    else {
+        /* Slide the front run to the end of the new array */
+        memcpy(new_array + new_capacity - front, new_array + self->head,
+               front * sizeof(PyObject *));
+        self->head = new_capacity - front;
     }
-    PyMem_Free(self->array);
+    return 0;
+}
+
+/* Make room for one more item in a full deque by doubling the backing array.
+   In incremental mode the items stay where they are and a migration to the
+   new array starts, so the cost does not depend on the size of the deque;
+   until it finishes, both arrays are held, about three times the old size.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_expand(ArrayDequeObject *self)
+{
+    PyObject **new_array;
+
+    assert(self->size == self->capacity);
+    if (!self->incremental)
+        return arraydeque_grow(self, self->capacity * 2);
+    arraydeque_settle(self);
+    new_array = arraydeque_array_alloc(self, self->capacity * 2);
+    if (new_array == NULL)
+        return -1;
+    self->old_array = self->array;
+    self->old_capacity = self->capacity;
+    self->migrate_lo = 0;
+    self->migrate_hi = self->size;
     self->array = new_array;
-    self->capacity = new_capacity;
-    self->head = new_head;
-    self->tail = new_head + self->size;
+    self->capacity *= 2;
+    arraydeque_update_shrink_limit(self);
+    return 0;
+}
+
+/* Detach and return the leftmost item of a non-empty deque; the caller
+   takes over its reference. */
+static inline PyObject *
+arraydeque_take_left(ArrayDequeObject *self)
+{
+    PyObject *item = *arraydeque_slot(self, 0);
+    self->head = arraydeque_pos(self, 1);
+    self->size--;
+    self->state++;
+    if (self->migrate_hi > 0) {
+        self->migrate_hi--;
+        if (self->migrate_lo > 0)
+            self->migrate_lo--;
+    }
+    return item;
+}
+
+/* Detach and return the rightmost item of a non-empty deque; the caller
+   takes over its reference. */
+static inline PyObject *
+arraydeque_take_right(ArrayDequeObject *self)
+{
+    PyObject *item = *arraydeque_slot(self, self->size - 1);
+    self->size--;
+    self->state++;
+    if (self->migrate_hi > self->size) {
+        self->migrate_hi = self->size;
+        if (self->migrate_lo > self->migrate_hi)
+            self->migrate_lo = self->migrate_hi;
+    }
+    return item;
+}
+
+/* Halve the backing array while its occupancy is below the shrink threshold,
+   stopping at the reserved capacity.  Since an array is only regrown once it
+   is completely full, a shrunk array is left between threshold and twice the
+   threshold full, which keeps pops and appends around a boundary from
+   thrashing.  Shrinking is an optimization, so failures are ignored. */
+static void
+arraydeque_shrink(ArrayDequeObject *self)
+{
+    Py_ssize_t new_capacity = self->capacity;
+
+    while (new_capacity > self->min_capacity &&
+           self->size < (Py_ssize_t)(new_capacity * self->shrink_threshold)) {
+        new_capacity /= 2;
+    }
+    if (new_capacity < self->capacity && arraydeque_resize(self, new_capacity) < 0)
+        PyErr_Clear();
+}
+
+/* Make room for at least n items without further reallocation and keep that
+   capacity reserved against automatic shrinking.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_reserve(ArrayDequeObject *self, Py_ssize_t n)
+{
+    Py_ssize_t new_capacity;
+
+    if (self->maxlen >= 0 && n > self->maxlen)
+        n = self->maxlen;
+    new_capacity = arraydeque_round_capacity(n);
+    if (new_capacity < 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (new_capacity > self->capacity && arraydeque_grow(self, new_capacity) < 0)
+        return -1;
+    if (new_capacity > self->min_capacity) {
+        self->min_capacity = new_capacity;
+        arraydeque_update_shrink_limit(self);
+    }
+    return 0;
+}
+
+/* Append an item to the right end, taking a new reference.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_append(ArrayDequeObject *self, PyObject *item)
+{
+    PyObject *old = NULL;
+
+    /* If maxlen is 0, do nothing. */
+    if (self->maxlen == 0)
+        return 0;
+
+    /* If bounded and full, drop the leftmost element. */
+    if (self->maxlen >= 0 && self->size == self->maxlen)
+        old = arraydeque_take_left(self);
+
+    /* Grow the internal array only when every slot is in use */
+    if (self->size == self->capacity) {
+        if (arraydeque_expand(self) < 0)
+            return -1;
+    }
+    Py_INCREF(item);
+    self->array[arraydeque_pos(self, self->size)] = item;
+    self->size++;
+    self->state++;
+    if (self->old_array != NULL)
+        arraydeque_migrate(self, ARRAYDEQUE_MIGRATE_STEP);
+    Py_XDECREF(old);
     return 0;
 }
 
@@ -59,30 +737,42 @@ arraydeque_resize(ArrayDequeObject *self, Py_ssize_t new_capacity)
 static PyObject *
 ArrayDeque_append(ArrayDequeObject *self, PyObject *arg)
 {
-    /* If maxlen is 0, do nothing. */
-    if (self->maxlen == 0) {
-        Py_RETURN_NONE;
-    }
+    if (arraydeque_append(self, arg) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
 
-    /* If bounded and full, drop the leftmost element. */
-    if (self->maxlen >= 0 && self->size == self->maxlen) {
-        PyObject *old = self->array[self->head];
-        Py_DECREF(old);
-        self->array[self->head] = NULL;
-        self->head++;
-        self->size--;
-    }
+/* Append an item to the left end, taking a new reference.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_appendleft(ArrayDequeObject *self, PyObject *item)
+{
+    PyObject *old = NULL;
 
-    /* Grow the internal array if needed */
-    if (self->tail >= self->capacity) {
-        if (arraydeque_resize(self, self->size * 2) < 0)
-            return NULL;
+    if (self->maxlen == 0)
+        return 0;
+
+    /* If bounded and full, drop the rightmost element */
+    if (self->maxlen >= 0 && self->size == self->maxlen)
+        old = arraydeque_take_right(self);
+
+    /* Grow the internal array only when every slot is in use */
+    if (self->size == self->capacity) {
+        if (arraydeque_expand(self) < 0)
+            return -1;
     }
-    Py_INCREF(arg);
-    self->array[self->tail] = arg;
-    self->tail++;
+    self->head = arraydeque_pos(self, -1);
+    Py_INCREF(item);
+    self->array[self->head] = item;
     self->size++;
-    Py_RETURN_NONE;
+    self->state++;
+    if (self->old_array != NULL) {
+        self->migrate_lo++;
+        self->migrate_hi++;
+        arraydeque_migrate(self, ARRAYDEQUE_MIGRATE_STEP);
+    }
+    Py_XDECREF(old);
+    return 0;
 }
 
 /* Method: appendleft(x)
@@ -92,27 +782,8 @@ ArrayDeque_append(ArrayDequeObject *self, PyObject *arg)
 static PyObject *
 ArrayDeque_appendleft(ArrayDequeObject *self, PyObject *arg)
 {
-    if (self->maxlen == 0) {
-        Py_RETURN_NONE;
-    }
-
-    /* If bounded and full, drop the rightmost element */
-    if (self->maxlen >= 0 && self->size == self->maxlen) {
-        self->tail--;
-        Py_DECREF(self->array[self->tail]);
-        self->array[self->tail] = NULL;
-        self->size--;
-    }
-
-    /* Grow the internal array if necessary */
-    if (self->head <= 0) {
-        if (arraydeque_resize(self, self->size * 2) < 0)
-            return NULL;
-    }
-    self->head--;
-    Py_INCREF(arg);
-    self->array[self->head] = arg;
-    self->size++;
+    if (arraydeque_appendleft(self, arg) < 0)
+        return NULL;
     Py_RETURN_NONE;
 }
 
@@ -125,10 +796,11 @@ ArrayDeque_pop(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
         PyErr_SetString(PyExc_IndexError, "pop from an empty deque");
         return NULL;
     }
-    self->tail--;
-    self->size--;
-    PyObject *item = self->array[self->tail];
-    self->array[self->tail] = NULL;
+    PyObject *item = arraydeque_take_right(self);
+    if (self->old_array != NULL)
+        arraydeque_migrate(self, ARRAYDEQUE_MIGRATE_STEP);
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
     return item;
 }
 
@@ -141,456 +813,2578 @@ ArrayDeque_popleft(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
         PyErr_SetString(PyExc_IndexError, "pop from an empty deque");
         return NULL;
     }
-    PyObject *item = self->array[self->head];
-    self->array[self->head] = NULL;
-    self->head++;
-    self->size--;
+    PyObject *item = arraydeque_take_left(self);
+    if (self->old_array != NULL)
+        arraydeque_migrate(self, ARRAYDEQUE_MIGRATE_STEP);
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
     return item;
 }
 
-/* Method: clear()
-   Remove all items from the deque. */
-static PyObject *
-ArrayDeque_clear(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+/* Reset an empty deque and give memory back down to the reserved capacity,
+   unless automatic shrinking is disabled.  Failures are ignored. */
+static void
+arraydeque_release_capacity(ArrayDequeObject *self)
 {
-    Py_ssize_t i;
-    for (i = self->head; i < self->tail; i++) {
-        Py_CLEAR(self->array[i]);
-    }
-    self->size = 0;
-    /* Reset head and tail to the center of the current allocation */
-    self->head = self->capacity / 2;
-    self->tail = self->head;
-    Py_RETURN_NONE;
+    assert(self->size == 0);
+    arraydeque_settle(self);
+    self->head = 0;
+    if (self->shrink_threshold > 0.0 && self->capacity > self->min_capacity &&
+        arraydeque_resize(self, self->min_capacity) < 0)
+        PyErr_Clear();
 }
 
-/* Method: extend(iterable)
-   Extend the right side of the deque by appending elements from the iterable. */
+/* Remove up to k items from the left end if left is true, or else from the
+   right end, and return them in the order they are popped.  k is clamped to
+   the size, so out of range counts pop everything.  Ownership of the items
+   moves to the returned list, so no reference counts change.
+   Returns NULL on failure, leaving the deque unchanged. */
 static PyObject *
-ArrayDeque_extend(ArrayDequeObject *self, PyObject *iterable)
+arraydeque_pop_many(ArrayDequeObject *self, Py_ssize_t k, int left)
 {
-    PyObject *iterator, *item;
-    iterator = PyObject_GetIter(iterable);
-    if (iterator == NULL)
+    PyObject *list;
+    PyObject **items;
+
+    if (k < 0) {
+        PyErr_SetString(PyExc_ValueError, "number of items must be non-negative");
         return NULL;
-    while ((item = PyIter_Next(iterator)) != NULL) {
-        if (ArrayDeque_append(self, item) == NULL) {
-            Py_DECREF(item);
-            Py_DECREF(iterator);
+    }
+    list = PyList_New(Py_MIN(k, self->size));
+    if (list == NULL)
+        return NULL;
+    /* Allocating the list may have run a finalizer that popped items */
+    if (PyList_GET_SIZE(list) > self->size)
+        Py_SET_SIZE(list, self->size);
+    k = PyList_GET_SIZE(list);
+    /* Popping nothing leaves the deque, and so its iterators, untouched */
+    if (k == 0)
+        return list;
+    items = ((PyListObject *)list)->ob_item;
+    arraydeque_settle(self);
+    if (left) {
+        arraydeque_copy_out(self, 0, k, items);
+        self->head = arraydeque_pos(self, k);
+    }
+    else {
+        for (Py_ssize_t i = 0; i < k; i++)
+            items[i] = self->array[arraydeque_pos(self, self->size - 1 - i)];
+    }
+    self->size -= k;
+    self->state++;
+    if (self->size == 0)
+        arraydeque_release_capacity(self);
+    else if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
+    return list;
+}
+
+/* Method: popleftn(k) -- remove up to k items from the left end as a list */
+static PyObject *
+ArrayDeque_popleftn(ArrayDequeObject *self, PyObject *arg)
+{
+    Py_ssize_t k = PyNumber_AsSsize_t(arg, NULL);
+    if (k == -1 && PyErr_Occurred())
+        return NULL;
+    return arraydeque_pop_many(self, k, 1);
+}
+
+/* Method: popn(k) -- remove up to k items from the right end as a list */
+static PyObject *
+ArrayDeque_popn(ArrayDequeObject *self, PyObject *arg)
+{
+    Py_ssize_t k = PyNumber_AsSsize_t(arg, NULL);
+    if (k == -1 && PyErr_Occurred())
+        return NULL;
+    return arraydeque_pop_many(self, k, 0);
+}
+
+/* Method: drain()
+   Remove all items and return them as a list, from left to right. */
+static PyObject *
+ArrayDeque_drain(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    return arraydeque_pop_many(self, self->size, 1);
+}
+
+/* Method: clear()
+   Remove all items from the deque. */
+static PyObject *
+ArrayDeque_clear(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    /* Detach each item before releasing it, so the deque stays consistent
+       if a destructor looks at it. */
+    while (self->size > 0) {
+        PyObject *item = arraydeque_take_left(self);
+        Py_DECREF(item);
+    }
+    arraydeque_release_capacity(self);
+    Py_RETURN_NONE;
+}
+
+/* Method: reserve(n)
+   Make room for at least n items; the capacity is kept from then on. */
+static PyObject *
+ArrayDeque_reserve(ArrayDequeObject *self, PyObject *arg)
+{
+    Py_ssize_t n = PyNumber_AsSsize_t(arg, PyExc_OverflowError);
+    if (n == -1 && PyErr_Occurred())
+        return NULL;
+    if (n < 0) {
+        PyErr_SetString(PyExc_ValueError, "reserve size must be non-negative");
+        return NULL;
+    }
+    if (arraydeque_reserve(self, n) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Method: shrink_to_fit()
+   Release unused capacity and drop any reservation. */
+static PyObject *
+ArrayDeque_shrink_to_fit(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t new_capacity = arraydeque_round_capacity(self->size);
+
+    assert(new_capacity > 0);
+    self->min_capacity = ARRAYDEQUE_MIN_CAPACITY;
+    if (new_capacity < self->capacity) {
+        if (arraydeque_resize(self, new_capacity) < 0)
             return NULL;
+    }
+    else {
+        arraydeque_update_shrink_limit(self);
+    }
+    Py_RETURN_NONE;
+}
+
+/* Make room to add n more items (at most maxlen in a bounded deque) at the
+   left end if left is true, or else at the right end, without further
+   reallocation.  The items they push out of the other end of a bounded deque
+   are detached into *evicted, a PyMem array of *num_evicted items, so that
+   the caller can release them once the deque is consistent again; see
+   arraydeque_release.
+   Returns 0 on success and -1 on failure, leaving the items unchanged. */
+static int
+arraydeque_prepare(ArrayDequeObject *self, Py_ssize_t n, int left,
+                   PyObject ***evicted, Py_ssize_t *num_evicted)
+{
+    Py_ssize_t evict = 0, need;
+
+    *evicted = NULL;
+    *num_evicted = 0;
+    arraydeque_settle(self);
+    need = self->size + n;
+    if (self->maxlen >= 0 && need > self->maxlen) {
+        assert(n <= self->maxlen);
+        evict = need - self->maxlen;
+        need = self->maxlen;
+    }
+    if (need > self->capacity) {
+        Py_ssize_t new_capacity = arraydeque_round_capacity(need);
+        if (new_capacity < 0) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        if (arraydeque_grow(self, new_capacity) < 0)
+            return -1;
+    }
+    if (evict > 0) {
+        *evicted = PyMem_New(PyObject *, evict);
+        if (*evicted == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        *num_evicted = evict;
+        if (left) {
+            arraydeque_copy_out(self, self->size - evict, evict, *evicted);
+        }
+        else {
+            arraydeque_copy_out(self, 0, evict, *evicted);
+            self->head = arraydeque_pos(self, evict);
+        }
+        self->size -= evict;
+        self->state++;
+    }
+    return 0;
+}
+
+/* Release the items detached by arraydeque_prepare. */
+static void
+arraydeque_release(PyObject **items, Py_ssize_t n)
+{
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_DECREF(items[i]);
+    PyMem_Free(items);
+}
+
+/* Append the n items of a C array at the right end, taking new references.
+   A bounded deque can only keep the last maxlen of them, so the others are
+   skipped rather than appended and evicted one at a time.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_extend_array(ArrayDequeObject *self, PyObject *const *items,
+                        Py_ssize_t n)
+{
+    PyObject **evicted;
+    Py_ssize_t num_evicted;
+
+    if (self->maxlen >= 0 && n > self->maxlen) {
+        items += n - self->maxlen;
+        n = self->maxlen;
+    }
+    if (n == 0)
+        return 0;
+    if (arraydeque_prepare(self, n, 0, &evicted, &num_evicted) < 0)
+        return -1;
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_INCREF(items[i]);
+    arraydeque_copy_in(self, self->size, items, n);
+    self->size += n;
+    self->state++;
+    arraydeque_release(evicted, num_evicted);
+    return 0;
+}
+
+/* Append the items of another deque at the right end, taking new
+   references.  Returns 0 on success and -1 on failure. */
+static int
+arraydeque_extend_deque(ArrayDequeObject *self, ArrayDequeObject *other)
+{
+    PyObject **evicted;
+    Py_ssize_t num_evicted, start = 0, n = other->size, pos, first;
+
+    assert(self != other);
+    if (self->maxlen >= 0 && n > self->maxlen) {
+        start = n - self->maxlen;
+        n = self->maxlen;
+    }
+    if (n == 0)
+        return 0;
+    arraydeque_settle(other);
+    if (arraydeque_prepare(self, n, 0, &evicted, &num_evicted) < 0)
+        return -1;
+    /* The items of other form at most two contiguous runs */
+    pos = arraydeque_pos(other, start);
+    first = Py_MIN(n, other->capacity - pos);
+    arraydeque_copy_in(self, self->size, other->array + pos, first);
+    arraydeque_copy_in(self, self->size + first, other->array, n - first);
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_INCREF(self->array[arraydeque_pos(self, self->size + i)]);
+    self->size += n;
+    self->state++;
+    arraydeque_release(evicted, num_evicted);
+    return 0;
+}
+
+/* Grow the backing array ahead of appending about n more items, as suggested
+   by a length hint.  This is only an optimization, so failures are ignored. */
+static void
+arraydeque_presize(ArrayDequeObject *self, Py_ssize_t n)
+{
+    Py_ssize_t target, new_capacity;
+
+    if (n > PY_SSIZE_T_MAX - self->size)
+        return;
+    target = self->size + n;
+    if (self->maxlen >= 0 && target > self->maxlen)
+        target = self->maxlen;
+    if (target <= self->capacity)
+        return;
+    new_capacity = arraydeque_round_capacity(target);
+    if (new_capacity > 0 && arraydeque_grow(self, new_capacity) < 0)
+        PyErr_Clear();
+}
+
+/* Give back the capacity that arraydeque_presize reserved for items that
+   never arrived, since a length hint may overestimate, the way list.extend
+   trims its overallocation.  Failures are ignored. */
+static void
+arraydeque_trim_presize(ArrayDequeObject *self)
+{
+    Py_ssize_t new_capacity = arraydeque_round_capacity(self->size);
+
+    if (new_capacity < self->min_capacity)
+        new_capacity = self->min_capacity;
+    if (new_capacity > 0 && new_capacity < self->capacity &&
+        arraydeque_resize(self, new_capacity) < 0)
+        PyErr_Clear();
+}
+
+/* Add the n items of a C array at the left end, each in front of the one
+   before it, taking new references.  Like arraydeque_extend_array, a bounded
+   deque only takes the last maxlen of them.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_extendleft_array(ArrayDequeObject *self, PyObject *const *items,
+                            Py_ssize_t n)
+{
+    PyObject **evicted;
+    Py_ssize_t num_evicted;
+
+    if (self->maxlen >= 0 && n > self->maxlen) {
+        items += n - self->maxlen;
+        n = self->maxlen;
+    }
+    if (n == 0)
+        return 0;
+    if (arraydeque_prepare(self, n, 1, &evicted, &num_evicted) < 0)
+        return -1;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        Py_INCREF(items[i]);
+        self->array[arraydeque_pos(self, -1 - i)] = items[i];
+    }
+    self->head = arraydeque_pos(self, -n);
+    self->size += n;
+    self->state++;
+    arraydeque_release(evicted, num_evicted);
+    return 0;
+}
+
+/* Add the items of another deque at the left end in reverse order, taking
+   new references.  Returns 0 on success and -1 on failure. */
+static int
+arraydeque_extendleft_deque(ArrayDequeObject *self, ArrayDequeObject *other)
+{
+    PyObject **evicted;
+    Py_ssize_t num_evicted, start = 0, n = other->size;
+
+    assert(self != other);
+    if (self->maxlen >= 0 && n > self->maxlen) {
+        start = n - self->maxlen;
+        n = self->maxlen;
+    }
+    if (n == 0)
+        return 0;
+    arraydeque_settle(other);
+    if (arraydeque_prepare(self, n, 1, &evicted, &num_evicted) < 0)
+        return -1;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = other->array[arraydeque_pos(other, start + i)];
+        Py_INCREF(item);
+        self->array[arraydeque_pos(self, -1 - i)] = item;
+    }
+    self->head = arraydeque_pos(self, -n);
+    self->size += n;
+    self->state++;
+    arraydeque_release(evicted, num_evicted);
+    return 0;
+}
+
+/* Add the items of iterable at the right end, or at the left end in reverse
+   order if left is true.  Lists, tuples and other deques are copied in bulk
+   after a single reservation, unless a subclass overrides iteration; other
+   iterables are presized from their length hint and added one at a time.
+   Incremental deques add every item one at a time without presizing: a bulk
+   copy would finish a pending migration and grow the array in one step, so
+   even a one-item extend could stall for the whole deque, while each append
+   only grows through arraydeque_expand and migrates a few slots.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_extend(ArrayDequeObject *self, PyObject *iterable, int left)
+{
+    PyObject *iterator, *item;
+    Py_ssize_t hint, capacity;
+    int result, presized;
+
+    if (iterable == (PyObject *)self) {
+        /* Copy first, since the source grows as it is read */
+        PyObject *list = PySequence_List(iterable);
+        if (list == NULL)
+            return -1;
+        result = arraydeque_extend(self, list, left);
+        Py_DECREF(list);
+        return result;
+    }
+    if (!self->incremental) {
+        if (PyList_CheckExact(iterable) || PyTuple_CheckExact(iterable)) {
+            PyObject *const *items = PySequence_Fast_ITEMS(iterable);
+            Py_ssize_t n = PySequence_Fast_GET_SIZE(iterable);
+            return left ? arraydeque_extendleft_array(self, items, n)
+                        : arraydeque_extend_array(self, items, n);
+        }
+        if (arraydeque_check(iterable) &&
+            Py_TYPE(iterable)->tp_iter == (getiterfunc)ArrayDeque_iter) {
+            ArrayDequeObject *other = (ArrayDequeObject *)iterable;
+            return left ? arraydeque_extendleft_deque(self, other)
+                        : arraydeque_extend_deque(self, other);
         }
+    }
+
+    iterator = PyObject_GetIter(iterable);
+    if (iterator == NULL)
+        return -1;
+    hint = PyObject_LengthHint(iterable, 0);
+    if (hint < 0) {
+        Py_DECREF(iterator);
+        return -1;
+    }
+    capacity = self->capacity;
+    if (hint > 0 && !self->incremental)
+        arraydeque_presize(self, hint);
+    presized = self->capacity > capacity;
+    while ((item = PyIter_Next(iterator)) != NULL) {
+        result = left ? arraydeque_appendleft(self, item)
+                      : arraydeque_append(self, item);
         Py_DECREF(item);
+        if (result < 0) {
+            Py_DECREF(iterator);
+            return -1;
+        }
     }
     Py_DECREF(iterator);
     if (PyErr_Occurred())
+        return -1;
+    if (presized)
+        arraydeque_trim_presize(self);
+    return 0;
+}
+
+/* Method: extend(iterable) -- append the items of iterable at the right end */
+static PyObject *
+ArrayDeque_extend(ArrayDequeObject *self, PyObject *iterable)
+{
+    if (arraydeque_extend(self, iterable, 0) < 0)
         return NULL;
     Py_RETURN_NONE;
 }
 
-/* Method: extendleft(iterable)
-   Extend the left side of the deque by appending elements from the iterable.
-   Note that left appends reverse the order relative to the input. */
+/* Method: extendleft(iterable) -- add the items at the left end in reverse */
 static PyObject *
 ArrayDeque_extendleft(ArrayDequeObject *self, PyObject *iterable)
 {
-    PyObject *list;
-    Py_ssize_t len, i;
-
-    list = PySequence_List(iterable);
-    if (list == NULL)
+    if (arraydeque_extend(self, iterable, 1) < 0)
         return NULL;
-    len = PyList_Size(list);
-    /* Iterate in forward order: each call to appendleft will
-       insert the item before the previous ones, thus reversing the input order. */
-    for (i = 0; i < len; i++) {
-        PyObject *item = PyList_GET_ITEM(list, i);
-        if (ArrayDeque_appendleft(self, item) == NULL) {
-            Py_DECREF(list);
-            return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Replace the m items starting at logical index start with the k items of a
+   C array, taking new references to them.  When the length changes, the
+   items on the shorter side of the range are moved with a single ring shift.
+   The replaced items are released last, once the deque is consistent again.
+   A bounded deque must have room for any items added; re-initializing with
+   a smaller maxlen can leave it over the bound, so deletions are allowed
+   regardless.
+   Returns 0 on success and -1 on failure, leaving the deque unchanged. */
+static int
+arraydeque_replace_range(ArrayDequeObject *self, Py_ssize_t start, Py_ssize_t m,
+                         PyObject *const *items, Py_ssize_t k)
+{
+    Py_ssize_t delta = k - m;
+    Py_ssize_t after = self->size - start - m;
+    PyObject **old = NULL;
+
+    assert(delta <= 0 || self->maxlen < 0 || self->size + delta <= self->maxlen);
+    arraydeque_settle(self);
+    if (self->size + delta > self->capacity) {
+        Py_ssize_t new_capacity = arraydeque_round_capacity(self->size + delta);
+        if (new_capacity < 0) {
+            PyErr_NoMemory();
+            return -1;
         }
+        if (arraydeque_grow(self, new_capacity) < 0)
+            return -1;
     }
-    Py_DECREF(list);
-    Py_RETURN_NONE;
+    if (m > 0) {
+        old = PyMem_New(PyObject *, m);
+        if (old == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        arraydeque_copy_out(self, start, m, old);
+    }
+    if (delta != 0) {
+        if (start <= after) {
+            /* Move the items before the range, and the head with them */
+            if (delta > 0)
+                arraydeque_ring_shift_backward(self, self->head, start, delta);
+            else
+                arraydeque_ring_shift_forward(self, self->head, start, -delta);
+            self->head = arraydeque_pos(self, -delta);
+        }
+        else {
+            /* Move the items after the range */
+            Py_ssize_t src = arraydeque_pos(self, start + m);
+            if (delta > 0)
+                arraydeque_ring_shift_forward(self, src, after, delta);
+            else
+                arraydeque_ring_shift_backward(self, src, after, -delta);
+        }
+        self->size += delta;
+        self->state++;
+    }
+    for (Py_ssize_t i = 0; i < k; i++)
+        Py_INCREF(items[i]);
+    arraydeque_copy_in(self, start, items, k);
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
+    if (old != NULL)
+        arraydeque_release(old, m);
+    return 0;
+}
+
+/* Detach and return the item at logical index i, closing the gap by moving
+   whichever side of it is shorter; the caller takes over its reference. */
+static PyObject *
+arraydeque_take_at(ArrayDequeObject *self, Py_ssize_t i)
+{
+    PyObject *item;
+
+    arraydeque_settle(self);
+    item = self->array[arraydeque_pos(self, i)];
+    if (i < self->size - 1 - i) {
+        arraydeque_ring_shift_forward(self, self->head, i, 1);
+        self->head = arraydeque_pos(self, 1);
+    }
+    else {
+        arraydeque_ring_shift_backward(self, arraydeque_pos(self, i + 1),
+                                       self->size - 1 - i, 1);
+    }
+    self->size--;
+    self->state++;
+    return item;
+}
+
+/* Check the number of positional arguments passed to a METH_FASTCALL
+   method, raising TypeError like PyArg_ParseTuple would.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_check_nargs(const char *name, Py_ssize_t nargs, Py_ssize_t min,
+                       Py_ssize_t max)
+{
+    if (nargs < min) {
+        PyErr_Format(PyExc_TypeError, "%s expected %s%zd argument%s, got %zd",
+                     name, min == max ? "" : "at least ", min,
+                     min == 1 ? "" : "s", nargs);
+        return -1;
+    }
+    if (nargs > max) {
+        PyErr_Format(PyExc_TypeError, "%s expected %s%zd argument%s, got %zd",
+                     name, min == max ? "" : "at most ", max,
+                     max == 1 ? "" : "s", nargs);
+        return -1;
+    }
+    return 0;
+}
+
+/* Convert an index argument to Py_ssize_t, like the "n" format unit.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_ssize_arg(PyObject *obj, Py_ssize_t *result)
+{
+    *result = PyNumber_AsSsize_t(obj, PyExc_OverflowError);
+    return *result == -1 && PyErr_Occurred() ? -1 : 0;
+}
+
+/* Rotate the items n steps to the right, or left if n is negative.
+   Rotating by k is the same as rotating the other way by size - k, so only
+   the shorter side is moved, with memmove and without touching reference
+   counts.  The items travel across the free part of the ring, so a full
+   array only needs its head index moved. */
+static void
+arraydeque_rotate(ArrayDequeObject *self, Py_ssize_t n)
+{
+    Py_ssize_t k, gap;
+
+    if (self->size <= 1)
+        return;
+    k = n % self->size;
+    if (k < 0)
+        k += self->size;
+    if (k == 0)
+        return;
+    arraydeque_settle(self);
+    gap = self->capacity - self->size;
+    if (k <= self->size - k) {
+        /* The last k items move to the front */
+        if (gap > 0)
+            arraydeque_ring_shift_forward(self, arraydeque_pos(self, self->size - k),
+                                          k, gap);
+        self->head = arraydeque_pos(self, -k);
+    }
+    else {
+        /* The first size - k items move to the back */
+        k = self->size - k;
+        if (gap > 0)
+            arraydeque_ring_shift_backward(self, self->head, k, gap);
+        self->head = arraydeque_pos(self, k);
+    }
+    self->state++;
 }
 
 /* Method: rotate(n=1)
    Rotate the deque n steps to the right. If n is negative, rotate left.
-   Each individual rotation is implemented using pop/popleft and append/appendleft.
 */
 static PyObject *
-ArrayDeque_rotate(ArrayDequeObject *self, PyObject *args)
+ArrayDeque_rotate(ArrayDequeObject *self, PyObject *const *args,
+                  Py_ssize_t nargs)
 {
-    long n = 1;
-    if (!PyArg_ParseTuple(args, "|l:rotate", &n))
+    Py_ssize_t n = 1;
+    if (arraydeque_check_nargs("rotate", nargs, 0, 1) < 0 ||
+        (nargs == 1 && arraydeque_ssize_arg(args[0], &n) < 0))
         return NULL;
-    if (self->size == 0) {
-        Py_RETURN_NONE;
+    arraydeque_rotate(self, n);
+    Py_RETURN_NONE;
+}
+
+/* Method: reverse()
+   Reverse the deque in place by swapping pointers across the live range.
+*/
+static PyObject *
+ArrayDeque_reverse(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    arraydeque_settle(self);
+    self->state++;
+    for (Py_ssize_t i = 0, j = self->size - 1; i < j; i++, j--) {
+        PyObject **left = &self->array[arraydeque_pos(self, i)];
+        PyObject **right = &self->array[arraydeque_pos(self, j)];
+        PyObject *tmp = *left;
+        *left = *right;
+        *right = tmp;
     }
-    n = n % self->size;
-    if (n > 0) {
-        for (long i = 0; i < n; i++) {
-            PyObject *item = ArrayDeque_pop(self, NULL);
-            if (item == NULL)
-                return NULL;
-            if (ArrayDeque_appendleft(self, item) == NULL) {
-                Py_DECREF(item);
-                return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Return the offset of the first of the n pointers at run that is needle,
+   or n if there is none. */
+static Py_ssize_t
+arraydeque_find_pointer(PyObject *const *run, Py_ssize_t n, PyObject *needle)
+{
+    Py_ssize_t i = 0;
+#if defined(ARRAYDEQUE_HAVE_AVX2)
+    const __m256i key = _mm256_set1_epi64x((long long)(uintptr_t)needle);
+    for (; i + 4 <= n; i += 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(run + i));
+        int mask = _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(block, key)));
+        if (mask != 0) {
+            while (!(mask & 1)) {
+                mask >>= 1;
+                i++;
             }
-            Py_DECREF(item);
+            return i;
         }
     }
-    else if (n < 0) {
-        n = -n;
-        for (long i = 0; i < n; i++) {
-            PyObject *item = ArrayDeque_popleft(self, NULL);
-            if (item == NULL)
-                return NULL;
-            if (ArrayDeque_append(self, item) == NULL) {
-                Py_DECREF(item);
-                return NULL;
+#elif defined(ARRAYDEQUE_HAVE_SSE2)
+    /* SSE2 has no 64-bit compare: a pointer matches when both halves do */
+    const __m128i key = _mm_set1_epi64x((long long)(uintptr_t)needle);
+    for (; i + 4 <= n; i += 4) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(run + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(run + i + 2));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(lo, key)) |
+                   _mm_movemask_epi8(_mm_cmpeq_epi32(hi, key)) << 16;
+        if (mask != 0) {
+            for (int j = 0; j < 4; j++, mask >>= 8) {
+                if ((mask & 0xFF) == 0xFF)
+                    return i + j;
             }
-            Py_DECREF(item);
         }
     }
-    Py_RETURN_NONE;
+#endif
+    for (; i < n; i++) {
+        if (run[i] == needle)
+            return i;
+    }
+    return n;
 }
 
-/* Method: remove(value)
-   Remove the first occurrence of value.
-*/
-static PyObject *
-ArrayDeque_remove(ArrayDequeObject *self, PyObject *value)
+/* Return the offset of the last of the n pointers at run that is needle,
+   or -1 if there is none. */
+static Py_ssize_t
+arraydeque_rfind_pointer(PyObject *const *run, Py_ssize_t n, PyObject *needle)
 {
-    Py_ssize_t i;
-    for (i = self->head; i < self->tail; i++) {
-        int cmp = PyObject_RichCompareBool(self->array[i], value, Py_EQ);
-        if (cmp < 0)
-            return NULL;
-        if (cmp)
-            break;
+    Py_ssize_t i = n;
+#if defined(ARRAYDEQUE_HAVE_AVX2)
+    const __m256i key = _mm256_set1_epi64x((long long)(uintptr_t)needle);
+    for (; i >= 4; i -= 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(run + i - 4));
+        int mask = _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(block, key)));
+        if (mask != 0) {
+            i--;
+            while (!(mask & 8)) {
+                mask <<= 1;
+                i--;
+            }
+            return i;
+        }
     }
-    if (i == self->tail) {
-        PyErr_SetString(PyExc_ValueError, "value not found in deque");
-        return NULL;
+#elif defined(ARRAYDEQUE_HAVE_SSE2)
+    const __m128i key = _mm_set1_epi64x((long long)(uintptr_t)needle);
+    for (; i >= 4; i -= 4) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(run + i - 4));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(run + i - 2));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(lo, key)) |
+                   _mm_movemask_epi8(_mm_cmpeq_epi32(hi, key)) << 16;
+        if (mask != 0) {
+            for (int j = 3; j >= 0; j--) {
+                if (((mask >> (8 * j)) & 0xFF) == 0xFF)
+                    return i - 4 + j;
+            }
+        }
     }
-    Py_DECREF(self->array[i]);
-    for (Py_ssize_t j = i; j < self->tail - 1; j++) {
-        self->array[j] = self->array[j+1];
+#endif
+    while (--i >= 0) {
+        if (run[i] == needle)
+            return i;
     }
-    self->array[self->tail - 1] = NULL;
-    self->tail--;
-    self->size--;
-    Py_RETURN_NONE;
+    return -1;
+}
+
+/* Kinds of needles whose equality with items of the builtin scalar types can
+   be decided without a rich comparison. */
+enum {
+    ARRAYDEQUE_NEEDLE_GENERIC,
+    ARRAYDEQUE_NEEDLE_INT,
+    ARRAYDEQUE_NEEDLE_FLOAT,
+    ARRAYDEQUE_NEEDLE_STR,
+    ARRAYDEQUE_NEEDLE_BYTES,
+};
+
+/* A value searched for in a deque, with what is needed to compare it
+   quickly, and the error raised if a comparison changes the deque. */
+typedef struct {
+    PyObject *value;
+    int kind;
+    long long_value;      /* value of an int needle that fits in a C long */
+    int long_overflow;    /* whether an int needle does not fit */
+    PyObject *mutated_error;
+    const char *mutated_message;
+} ArrayDequeNeedle;
+
+static void
+arraydeque_needle_init(ArrayDequeNeedle *needle, PyObject *value)
+{
+    needle->value = value;
+    needle->kind = ARRAYDEQUE_NEEDLE_GENERIC;
+    needle->long_value = 0;
+    needle->long_overflow = 0;
+    needle->mutated_error = PyExc_RuntimeError;
+    needle->mutated_message = "deque mutated during iteration";
+    if (PyLong_CheckExact(value)) {
+        needle->kind = ARRAYDEQUE_NEEDLE_INT;
+        needle->long_value = PyLong_AsLongAndOverflow(value,
+                                                      &needle->long_overflow);
+    }
+    else if (PyFloat_CheckExact(value)) {
+        needle->kind = ARRAYDEQUE_NEEDLE_FLOAT;
+    }
+    else if (PyUnicode_CheckExact(value)) {
+        needle->kind = ARRAYDEQUE_NEEDLE_STR;
+    }
+    else if (PyBytes_CheckExact(value)) {
+        needle->kind = ARRAYDEQUE_NEEDLE_BYTES;
+    }
+}
+
+/* Compare a non-identical item with a typed needle directly.  Returns 1 or 0
+   when the result is known, or -1 when a rich comparison is needed. */
+static inline int
+arraydeque_scalar_equal(PyObject *item, const ArrayDequeNeedle *needle)
+{
+    PyObject *value = needle->value;
+
+    switch (needle->kind) {
+    case ARRAYDEQUE_NEEDLE_INT:
+        if (PyLong_CheckExact(item)) {
+            int overflow;
+            long v;
+            if (needle->long_overflow)
+                return -1;
+            v = PyLong_AsLongAndOverflow(item, &overflow);
+            return !overflow && v == needle->long_value;
+        }
+        if (PyUnicode_CheckExact(item) || PyBytes_CheckExact(item))
+            return 0;
+        return -1;
+    case ARRAYDEQUE_NEEDLE_FLOAT:
+        if (PyFloat_CheckExact(item))
+            return PyFloat_AS_DOUBLE(item) == PyFloat_AS_DOUBLE(value);
+        if (PyUnicode_CheckExact(item) || PyBytes_CheckExact(item))
+            return 0;
+        return -1;
+    case ARRAYDEQUE_NEEDLE_STR:
+        if (PyUnicode_CheckExact(item)) {
+            Py_ssize_t len = PyUnicode_GET_LENGTH(item);
+            return len == PyUnicode_GET_LENGTH(value) &&
+                   PyUnicode_KIND(item) == PyUnicode_KIND(value) &&
+                   memcmp(PyUnicode_DATA(item), PyUnicode_DATA(value),
+                          len * PyUnicode_KIND(item)) == 0;
+        }
+        if (PyLong_CheckExact(item) || PyFloat_CheckExact(item) ||
+            PyBytes_CheckExact(item))
+            return 0;
+        return -1;
+    case ARRAYDEQUE_NEEDLE_BYTES:
+        if (PyBytes_CheckExact(item)) {
+            Py_ssize_t len = PyBytes_GET_SIZE(item);
+            return len == PyBytes_GET_SIZE(value) &&
+                   memcmp(PyBytes_AS_STRING(item), PyBytes_AS_STRING(value),
+                          len) == 0;
+        }
+        if (PyLong_CheckExact(item) || PyFloat_CheckExact(item) ||
+            PyUnicode_CheckExact(item))
+            return 0;
+        return -1;
+    default:
+        return -1;
+    }
+}
+
+/* Test whether the item in slot equals the needle: identical objects first,
+   then typed values, and only then a rich comparison.  Returns 1 or 0, or -1
+   with an exception set on failure, including when a rich comparison changed
+   the layout of the deque or the slot. */
+static inline int
+arraydeque_match(ArrayDequeObject *self, const ArrayDequeNeedle *needle,
+                 PyObject **slot)
+{
+    PyObject *item = *slot;
+    PyObject **array;
+    Py_ssize_t size, head, capacity;
+    int cmp;
+
+    if (item == needle->value)
+        return 1;
+    cmp = arraydeque_scalar_equal(item, needle);
+    if (cmp >= 0)
+        return cmp;
+    array = self->array;
+    size = self->size;
+    head = self->head;
+    capacity = self->capacity;
+    Py_INCREF(item);
+    cmp = PyObject_RichCompareBool(item, needle->value, Py_EQ);
+    Py_DECREF(item);
+    if (cmp >= 0 &&
+        (self->array != array || self->size != size || self->head != head ||
+         self->capacity != capacity || *slot != item)) {
+        PyErr_SetString(needle->mutated_error, needle->mutated_message);
+        return -1;
+    }
+    return cmp;
+}
+
+/* Scan [start, stop) for items equal to the needle, one block of contiguous
+   slots at a time.  Identical pointers are located with a vectorized scan,
+   so only the items in front of them need comparing by value.  With count
+   NULL, return the logical index of the first match (or of the last one when
+   reverse is true), or -1 if there is none.  Otherwise store the number of
+   matches in *count and return -1.  Returns -2 with an exception set on
+   failure. */
+static Py_ssize_t
+arraydeque_scan(ArrayDequeObject *self, const ArrayDequeNeedle *needle,
+                Py_ssize_t start, Py_ssize_t stop, int reverse,
+                Py_ssize_t *count)
+{
+    arraydeque_settle(self);
+    if (count != NULL)
+        *count = 0;
+    while (start < stop) {
+        Py_ssize_t pos, len, hit, k;
+        PyObject **run;
+        int cmp;
+
+        if (!reverse) {
+            pos = arraydeque_pos(self, start);
+            len = Py_MIN(stop - start, self->capacity - pos);
+            len = Py_MIN(len, ARRAYDEQUE_SCAN_BLOCK);
+            run = self->array + pos;
+            hit = arraydeque_find_pointer(run, len, needle->value);
+            for (k = 0; k < hit; k++) {
+                cmp = arraydeque_match(self, needle, &run[k]);
+                if (cmp < 0)
+                    return -2;
+                if (cmp && count == NULL)
+                    return start + k;
+                if (cmp)
+                    ++*count;
+            }
+            /* Comparisons may have stored something else at the hit */
+            if (hit < len && run[hit] != needle->value) {
+                start += hit;
+                continue;
+            }
+            if (hit < len && count == NULL)
+                return start + hit;
+            if (hit < len)
+                ++*count;
+            start += Py_MIN(hit + 1, len);
+        }
+        else {
+            pos = arraydeque_pos(self, stop - 1);
+            len = Py_MIN(stop - start, pos + 1);
+            len = Py_MIN(len, ARRAYDEQUE_SCAN_BLOCK);
+            run = self->array + pos + 1 - len;
+            hit = arraydeque_rfind_pointer(run, len, needle->value);
+            for (k = len - 1; k > hit; k--) {
+                cmp = arraydeque_match(self, needle, &run[k]);
+                if (cmp < 0)
+                    return -2;
+                if (cmp && count == NULL)
+                    return stop - len + k;
+                if (cmp)
+                    ++*count;
+            }
+            if (hit >= 0 && run[hit] != needle->value) {
+                stop -= len - 1 - hit;
+                continue;
+            }
+            if (hit >= 0 && count == NULL)
+                return stop - len + hit;
+            if (hit >= 0)
+                ++*count;
+            stop -= len - Py_MAX(hit, 0);
+        }
+    }
+    return -1;
+}
+
+/* Method: remove(value)
+   Remove the first occurrence of value, moving whichever side of it is
+   shorter.
+*/
+static PyObject *
+ArrayDeque_remove(ArrayDequeObject *self, PyObject *value)
+{
+    ArrayDequeNeedle needle;
+    Py_ssize_t i;
+    PyObject *item;
+
+    arraydeque_needle_init(&needle, value);
+    needle.mutated_error = PyExc_IndexError;
+    needle.mutated_message = "deque mutated during remove().";
+    i = arraydeque_scan(self, &needle, 0, self->size, 0, NULL);
+    if (i == -2)
+        return NULL;
+    if (i == -1) {
+        PyErr_SetString(PyExc_ValueError, "value not found in deque");
+        return NULL;
+    }
+    item = arraydeque_take_at(self, i);
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
+    Py_DECREF(item);
+    Py_RETURN_NONE;
+}
+
+/* Return whether a < b, comparing exact ints, floats and strs directly.
+   Returns 1 or 0, or -1 with an exception set on failure, including when a
+   rich comparison changed the layout of the deque. */
+static int
+arraydeque_less(ArrayDequeObject *self, PyObject *a, PyObject *b)
+{
+    PyObject **array;
+    Py_ssize_t size, head, capacity;
+    int cmp;
+
+    if (Py_TYPE(a) == Py_TYPE(b)) {
+        if (PyFloat_CheckExact(a))
+            return PyFloat_AS_DOUBLE(a) < PyFloat_AS_DOUBLE(b);
+        if (PyLong_CheckExact(a)) {
+            int overflow_a, overflow_b;
+            long va = PyLong_AsLongAndOverflow(a, &overflow_a);
+            long vb = PyLong_AsLongAndOverflow(b, &overflow_b);
+            if (!overflow_a && !overflow_b)
+                return va < vb;
+        }
+        else if (PyUnicode_CheckExact(a)) {
+            return PyUnicode_Compare(a, b) < 0;
+        }
+    }
+    array = self->array;
+    size = self->size;
+    head = self->head;
+    capacity = self->capacity;
+    Py_INCREF(a);
+    Py_INCREF(b);
+    cmp = PyObject_RichCompareBool(a, b, Py_LT);
+    Py_DECREF(a);
+    Py_DECREF(b);
+    if (cmp >= 0 &&
+        (self->array != array || self->size != size || self->head != head ||
+         self->capacity != capacity)) {
+        PyErr_SetString(PyExc_ValueError, "deque modified during sort");
+        return -1;
+    }
+    return cmp;
+}
+
+/* Return 1 if sort() would leave the items where they are, 0 if not, or -1
+   on failure.  The sort is stable, so only a strict inversion between
+   neighbours moves anything. */
+static int
+arraydeque_is_sorted(ArrayDequeObject *self, int reverse)
+{
+    arraydeque_settle(self);
+    for (Py_ssize_t i = 1; i < self->size; i++) {
+        PyObject *prev = self->array[arraydeque_pos(self, i - 1)];
+        PyObject *item = self->array[arraydeque_pos(self, i)];
+        int cmp = reverse ? arraydeque_less(self, prev, item)
+                          : arraydeque_less(self, item, prev);
+        if (cmp != 0)
+            return cmp < 0 ? -1 : 0;
+    }
+    return 1;
+}
+
+/* Method: sort(*, key=None, reverse=False)
+   Sort the items in place, with the same semantics as list.sort.  The
+   pointers are lent to a list for the duration of list.sort, so no
+   reference counts change and the deque appears empty while key functions
+   and comparisons run.  Without a key, items that are already in order are
+   left untouched.
+*/
+static PyObject *
+ArrayDeque_sort(ArrayDequeObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"key", "reverse", NULL};
+    PyObject *key = Py_None, *list, *sort, *result, *intruders = NULL;
+    PyObject **items;
+    Py_ssize_t n, min_capacity;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$Op:sort", kwlist,
+                                     &key, &reverse))
+        return NULL;
+    if (key == Py_None) {
+        int sorted = arraydeque_is_sorted(self, reverse);
+        if (sorted < 0)
+            return NULL;
+        if (sorted)
+            Py_RETURN_NONE;
+    }
+    do {
+        n = self->size;
+        list = PyList_New(n);
+        if (list == NULL)
+            return NULL;
+        /* Allocating the list may have run a finalizer that changed the size */
+        if (self->size == n)
+            break;
+        Py_DECREF(list);
+    } while (1);
+    sort = PyObject_GetAttrString(list, "sort");
+    if (sort == NULL) {
+        Py_DECREF(list);
+        return NULL;
+    }
+
+    /* Lend the items to the list, and keep the array from shrinking if the
+       deque is used while it is empty */
+    items = ((PyListObject *)list)->ob_item;
+    arraydeque_settle(self);
+    arraydeque_copy_out(self, 0, n, items);
+    self->size = 0;
+    self->state++;
+    self->head = 0;
+    min_capacity = self->min_capacity;
+    self->min_capacity = self->capacity;
+    arraydeque_update_shrink_limit(self);
+
+    result = PyObject_Call(sort, args, kwds);
+    Py_DECREF(sort);
+
+    /* Take the items back, even when the sort failed */
+    if (self->size > 0) {
+        intruders = arraydeque_pop_many(self, self->size, 1);
+        if (result != NULL) {
+            Py_CLEAR(result);
+            if (intruders != NULL)
+                PyErr_SetString(PyExc_ValueError, "deque modified during sort");
+        }
+    }
+    self->min_capacity = min_capacity;
+    arraydeque_settle(self);
+    if (self->size == 0 && (n <= self->capacity ||
+        arraydeque_grow(self, arraydeque_round_capacity(n)) == 0)) {
+        items = ((PyListObject *)list)->ob_item;
+        self->head = 0;
+        arraydeque_copy_in(self, 0, items, n);
+        self->size = n;
+        self->state++;
+        Py_SET_SIZE(list, 0);
+    }
+    else if (result != NULL) {
+        /* The items could not be put back and are released with the list */
+        Py_CLEAR(result);
+    }
+    arraydeque_update_shrink_limit(self);
+    Py_DECREF(list);
+    Py_XDECREF(intruders);
+    if (result == NULL)
+        return NULL;
+    Py_DECREF(result);
+    Py_RETURN_NONE;
+}
+
+/* Method: insert(i, x)
+   Insert x before position i, moving whichever side of it is shorter.
+   Like list.insert, out of range positions insert at the nearest end.
+*/
+static PyObject *
+ArrayDeque_insert(ArrayDequeObject *self, PyObject *const *args,
+                  Py_ssize_t nargs)
+{
+    Py_ssize_t index;
+    PyObject *value;
+
+    if (arraydeque_check_nargs("insert", nargs, 2, 2) < 0 ||
+        arraydeque_ssize_arg(args[0], &index) < 0)
+        return NULL;
+    value = args[1];
+    if (self->maxlen >= 0 && self->size >= self->maxlen) {
+        PyErr_SetString(PyExc_IndexError, "deque already at its maximum size");
+        return NULL;
+    }
+    if (index < 0) {
+        index += self->size;
+        if (index < 0)
+            index = 0;
+    }
+    if (index > self->size)
+        index = self->size;
+    if (arraydeque_replace_range(self, index, 0, &value, 1) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/* Remove every item that equals value, or with a predicate, every item for
+   which it returns a false value.  All items are tested first, and the
+   survivors are then compacted in a single pass with a read and a write
+   cursor, from whichever end leaves fewer items to move.  Removed items are
+   released once the deque is consistent again.
+   Returns the number of removed items, or -1 on failure, in which case the
+   deque is left unchanged. */
+static Py_ssize_t
+arraydeque_remove_matching(ArrayDequeObject *self, PyObject *value,
+                           PyObject *predicate)
+{
+    Py_ssize_t n, head, first = -1, last = -1, removed = 0, i, w, j = 0;
+    PyObject **array, **old;
+    ArrayDequeNeedle needle;
+    char *doomed;
+
+    if (predicate == NULL)
+        arraydeque_needle_init(&needle, value);
+    arraydeque_settle(self);
+    n = self->size;
+    if (n == 0)
+        return 0;
+    head = self->head;
+    array = self->array;
+    doomed = PyMem_Malloc(n);
+    if (doomed == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        PyObject *item = array[arraydeque_pos(self, i)];
+        int match;
+
+        Py_INCREF(item);
+        if (predicate != NULL) {
+            PyObject *keep = PyObject_CallFunctionObjArgs(predicate, item, NULL);
+            match = -1;
+            if (keep != NULL) {
+                int truth = PyObject_IsTrue(keep);
+                Py_DECREF(keep);
+                if (truth >= 0)
+                    match = !truth;
+            }
+        }
+        else {
+            match = arraydeque_match(self, &needle, &array[arraydeque_pos(self, i)]);
+        }
+        Py_DECREF(item);
+        if (match < 0)
+            goto error;
+        if (self->size != n || self->head != head || self->array != array ||
+            array[arraydeque_pos(self, i)] != item) {
+            PyErr_SetString(PyExc_RuntimeError, "deque mutated during iteration");
+            goto error;
+        }
+        doomed[i] = (char)match;
+        if (match) {
+            if (first < 0)
+                first = i;
+            last = i;
+            removed++;
+        }
+    }
+    if (removed == 0) {
+        PyMem_Free(doomed);
+        return 0;
+    }
+    old = PyMem_New(PyObject *, removed);
+    if (old == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (n - first <= last + 1) {
+        /* Pull the survivors after the first removed item to the left */
+        for (i = w = first; i < n; i++) {
+            PyObject *item = array[arraydeque_pos(self, i)];
+            if (doomed[i])
+                old[j++] = item;
+            else
+                array[arraydeque_pos(self, w++)] = item;
+        }
+    }
+    else {
+        /* Push the survivors before the last removed item to the right */
+        for (i = w = last; i >= 0; i--) {
+            PyObject *item = array[arraydeque_pos(self, i)];
+            if (doomed[i])
+                old[j++] = item;
+            else
+                array[arraydeque_pos(self, w--)] = item;
+        }
+        self->head = arraydeque_pos(self, removed);
+    }
+    assert(j == removed);
+    PyMem_Free(doomed);
+    self->size -= removed;
+    self->state++;
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
+    arraydeque_release(old, removed);
+    return removed;
+
+error:
+    PyMem_Free(doomed);
+    return -1;
+}
+
+/* Method: remove_all(value)
+   Remove every occurrence of value and return how many were removed.
+*/
+static PyObject *
+ArrayDeque_remove_all(ArrayDequeObject *self, PyObject *value)
+{
+    Py_ssize_t removed = arraydeque_remove_matching(self, value, NULL);
+    if (removed < 0)
+        return NULL;
+    return PyLong_FromSsize_t(removed);
+}
+
+/* Method: filter_inplace(predicate)
+   Keep only the items for which predicate(item) is true and return how many
+   were removed.
+*/
+static PyObject *
+ArrayDeque_filter_inplace(ArrayDequeObject *self, PyObject *predicate)
+{
+    Py_ssize_t removed = arraydeque_remove_matching(self, NULL, predicate);
+    if (removed < 0)
+        return NULL;
+    return PyLong_FromSsize_t(removed);
+}
+
+/* Argument converter for index bounds: any integer, clamped to the range
+   of Py_ssize_t. */
+static int
+arraydeque_bound_converter(PyObject *obj, void *result)
+{
+    Py_ssize_t value = PyNumber_AsSsize_t(obj, NULL);
+    if (value == -1 && PyErr_Occurred())
+        return 0;
+    *(Py_ssize_t *)result = value;
+    return 1;
+}
+
+/* Shared implementation of index() and rindex(). */
+static PyObject *
+arraydeque_index(ArrayDequeObject *self, PyObject *const *args,
+                 Py_ssize_t nargs, int reverse)
+{
+    PyObject *value;
+    ArrayDequeNeedle needle;
+    Py_ssize_t start = 0, stop = PY_SSIZE_T_MAX, i;
+
+    if (arraydeque_check_nargs(reverse ? "rindex" : "index", nargs, 1, 3) < 0 ||
+        (nargs > 1 && !arraydeque_bound_converter(args[1], &start)) ||
+        (nargs > 2 && !arraydeque_bound_converter(args[2], &stop)))
+        return NULL;
+    value = args[0];
+    /* Negative bounds count from the end, like slice indices */
+    if (start < 0) {
+        start += self->size;
+        if (start < 0)
+            start = 0;
+    }
+    if (stop < 0) {
+        stop += self->size;
+        if (stop < 0)
+            stop = 0;
+    }
+    if (stop > self->size)
+        stop = self->size;
+    arraydeque_needle_init(&needle, value);
+    i = arraydeque_scan(self, &needle, start, stop, reverse, NULL);
+    if (i == -2)
+        return NULL;
+    if (i == -1) {
+        PyErr_Format(PyExc_ValueError, "%R is not in deque", value);
+        return NULL;
+    }
+    return PyLong_FromSsize_t(i);
+}
+
+/* Method: index(value[, start[, stop]])
+   Return the index of the first occurrence of value in d[start:stop].
+*/
+static PyObject *
+ArrayDeque_index(ArrayDequeObject *self, PyObject *const *args,
+                 Py_ssize_t nargs)
+{
+    return arraydeque_index(self, args, nargs, 0);
+}
+
+/* Method: rindex(value[, start[, stop]])
+   Return the index of the last occurrence of value in d[start:stop],
+   scanning from the right.
+*/
+static PyObject *
+ArrayDeque_rindex(ArrayDequeObject *self, PyObject *const *args,
+                  Py_ssize_t nargs)
+{
+    return arraydeque_index(self, args, nargs, 1);
+}
+
+/* Method: count(value)
+   Count the number of occurrences of value.
+*/
+static PyObject *
+ArrayDeque_count(ArrayDequeObject *self, PyObject *value)
+{
+    ArrayDequeNeedle needle;
+    Py_ssize_t count;
+
+    arraydeque_needle_init(&needle, value);
+    if (arraydeque_scan(self, &needle, 0, self->size, 0, &count) == -2)
+        return NULL;
+    return PyLong_FromSsize_t(count);
+}
+
+/* Sequence protocol: __len__ support */
+static Py_ssize_t
+ArrayDeque_length(ArrayDequeObject *self)
+{
+    return self->size;
+}
+
+/* Sequence protocol: __getitem__ support (only for integer indices) */
+static PyObject *
+ArrayDeque_seq_getitem(ArrayDequeObject *self, Py_ssize_t index)
+{
+    if (index < 0)
+        index += self->size;
+    if (index < 0 || index >= self->size) {
+        PyErr_SetString(PyExc_IndexError, "deque index out of range");
+        return NULL;
+    }
+    PyObject *item = *arraydeque_slot(self, index);
+    Py_INCREF(item);
+    return item;
+}
+
+/* Return the items selected by a slice as a new, unbounded ArrayDeque.
+   Contiguous slices are copied with memcpy. */
+static PyObject *
+arraydeque_get_slice(ArrayDequeObject *self, PyObject *slice)
+{
+    Py_ssize_t start, stop, step, n;
+    ArrayDequeObject *result;
+
+    if (PySlice_Unpack(slice, &start, &stop, &step) < 0)
+        return NULL;
+    result = (ArrayDequeObject *)ArrayDeque_new(
+        arraydeque_state_of(Py_TYPE(self))->deque_type, NULL, NULL);
+    if (result == NULL)
+        return NULL;
+    /* Only clip the bounds once nothing can run Python code any more */
+    n = PySlice_AdjustIndices(self->size, &start, &stop, step);
+    if (n == 0)
+        return (PyObject *)result;
+    arraydeque_settle(self);
+    if (n > result->capacity &&
+        arraydeque_grow(result, arraydeque_round_capacity(n)) < 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    if (step == 1) {
+        arraydeque_copy_out(self, start, n, result->array);
+    }
+    else {
+        for (Py_ssize_t i = 0; i < n; i++)
+            result->array[i] = self->array[arraydeque_pos(self, start + i * step)];
+    }
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_INCREF(result->array[i]);
+    result->size = n;
+    return (PyObject *)result;
+}
+
+/* Mapping protocol: __getitem__ support for integers and slices */
+static PyObject *
+ArrayDeque_getitem(ArrayDequeObject *self, PyObject *key)
+{
+    if (PySlice_Check(key))
+        return arraydeque_get_slice(self, key);
+    if (!PyLong_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "deque indices must be integers or slices");
+        return NULL;
+    }
+    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (index == -1 && PyErr_Occurred())
+        return NULL;
+    return ArrayDeque_seq_getitem(self, index);
+}
+
+/* Delete the m items at start, start + step, ... (step > 1) by compacting
+   the items after the first of them.
+   Returns 0 on success and -1 on failure, leaving the deque unchanged. */
+static int
+arraydeque_delete_extended(ArrayDequeObject *self, Py_ssize_t start,
+                           Py_ssize_t step, Py_ssize_t m)
+{
+    PyObject **old = PyMem_New(PyObject *, m);
+    Py_ssize_t next = start, w = start, j = 0;
+
+    if (old == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    arraydeque_settle(self);
+    for (Py_ssize_t i = start; i < self->size; i++) {
+        PyObject *item = self->array[arraydeque_pos(self, i)];
+        if (j < m && i == next) {
+            old[j++] = item;
+            next += step;
+        }
+        else {
+            self->array[arraydeque_pos(self, w++)] = item;
+        }
+    }
+    self->size -= m;
+    self->state++;
+    if (self->size < self->shrink_limit)
+        arraydeque_shrink(self);
+    arraydeque_release(old, m);
+    return 0;
+}
+
+/* Assign the items of value to, or delete when value is NULL, the items
+   selected by a slice.  Contiguous slices may change the length of the
+   deque (within maxlen); extended slices must keep it.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_set_slice(ArrayDequeObject *self, PyObject *slice, PyObject *value)
+{
+    Py_ssize_t start, stop, step, m, k;
+    PyObject **items, **old;
+    PyObject *seq;
+    int result = -1;
+
+    if (PySlice_Unpack(slice, &start, &stop, &step) < 0)
+        return -1;
+    if (value == NULL) {
+        m = PySlice_AdjustIndices(self->size, &start, &stop, step);
+        if (m == 0)
+            return 0;
+        if (step < 0) {
+            /* Delete the same items front to back */
+            start += (m - 1) * step;
+            step = -step;
+        }
+        if (step == 1 || m <= 1)
+            return arraydeque_replace_range(self, start, m, NULL, 0);
+        return arraydeque_delete_extended(self, start, step, m);
+    }
+
+    /* Copies the deque itself, so it cannot change under the assignment */
+    seq = PySequence_Fast(value, "can only assign an iterable");
+    if (seq == NULL)
+        return -1;
+    items = PySequence_Fast_ITEMS(seq);
+    k = PySequence_Fast_GET_SIZE(seq);
+    m = PySlice_AdjustIndices(self->size, &start, &stop, step);
+    if (step == 1) {
+        if (self->maxlen >= 0 && self->size - m + k > self->maxlen) {
+            PyErr_SetString(PyExc_ValueError,
+                            "slice assignment would exceed the deque's maxlen");
+            goto done;
+        }
+        result = arraydeque_replace_range(self, start, m, items, k);
+        goto done;
+    }
+    if (k != m) {
+        PyErr_Format(PyExc_ValueError,
+                     "attempt to assign sequence of size %zd to extended slice of size %zd",
+                     k, m);
+        goto done;
+    }
+    if (m == 0) {
+        result = 0;
+        goto done;
+    }
+    old = PyMem_New(PyObject *, m);
+    if (old == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    arraydeque_settle(self);
+    for (Py_ssize_t i = 0; i < m; i++) {
+        PyObject **slot = &self->array[arraydeque_pos(self, start + i * step)];
+        old[i] = *slot;
+        Py_INCREF(items[i]);
+        *slot = items[i];
+    }
+    arraydeque_release(old, m);
+    result = 0;
+done:
+    Py_DECREF(seq);
+    return result;
+}
+
+/* Sequence protocol: __setitem__ and __delitem__ support (only for integer
+   indices) */
+static int
+ArrayDeque_seq_setitem(ArrayDequeObject *self, Py_ssize_t index, PyObject *value)
+{
+    if (index < 0)
+        index += self->size;
+    /* A NULL value asks for deletion */
+    if (value == NULL) {
+        if (index < 0 || index >= self->size) {
+            PyErr_SetString(PyExc_IndexError, "deque index out of range");
+            return -1;
+        }
+        PyObject *item = arraydeque_take_at(self, index);
+        if (self->size < self->shrink_limit)
+            arraydeque_shrink(self);
+        Py_DECREF(item);
+        return 0;
+    }
+    if (index < 0 || index >= self->size) {
+        PyErr_SetString(PyExc_IndexError, "deque assignment index out of range");
+        return -1;
+    }
+    PyObject **slot = arraydeque_slot(self, index);
+    PyObject *old = *slot;
+    Py_INCREF(value);
+    *slot = value;
+    Py_DECREF(old);
+    return 0;
+}
+
+/* Mapping protocol: __setitem__ and __delitem__ support for integers and
+   slices */
+static int
+ArrayDeque_setitem(ArrayDequeObject *self, PyObject *key, PyObject *value)
+{
+    if (PySlice_Check(key))
+        return arraydeque_set_slice(self, key, value);
+    if (!PyLong_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "deque indices must be integers or slices");
+        return -1;
+    }
+    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (index == -1 && PyErr_Occurred())
+        return -1;
+    return ArrayDeque_seq_setitem(self, index, value);
+}
+
+/* __contains__ implementation */
+static int
+ArrayDeque_contains(ArrayDequeObject *self, PyObject *value)
+{
+    ArrayDequeNeedle needle;
+    Py_ssize_t i;
+
+    arraydeque_needle_init(&needle, value);
+    i = arraydeque_scan(self, &needle, 0, self->size, 0, NULL);
+    if (i == -2)
+        return -1;
+    return i >= 0;
+}
+
+/* Return a borrowed reference to item i of an ArrayDeque (when deque is
+   set), list or tuple being compared, or NULL once i is past its current
+   end. */
+static inline PyObject *
+arraydeque_compare_item(PyObject *seq, ArrayDequeObject *deque, Py_ssize_t i)
+{
+    if (deque != NULL)
+        return i < deque->size ? *arraydeque_slot(deque, i) : NULL;
+    if (PyList_Check(seq))
+        return i < PyList_GET_SIZE(seq) ? PyList_GET_ITEM(seq, i) : NULL;
+    return i < PyTuple_GET_SIZE(seq) ? PyTuple_GET_ITEM(seq, i) : NULL;
+}
+
+/* Rich comparison support: lexicographic, like collections.deque and list.
+   The other operand may be another ArrayDeque, a list or a tuple, whose
+   items are walked in lockstep with ours; other sequences are copied into a
+   list first.  == and != return as soon as the lengths or an item differ,
+   and equality is decided without a rich comparison for identical items and
+   for exact ints, floats, strs and bytes.  Changing a deque during a
+   comparison raises RuntimeError. */
+static PyObject *
+ArrayDeque_richcompare(PyObject *self, PyObject *other, int op)
+{
+    ArrayDequeObject *deque = (ArrayDequeObject *)self, *other_deque = NULL;
+    PyObject *list = NULL, *result, *a = NULL, *b = NULL;
+    Py_ssize_t i, self_size, other_size;
+
+    if (!arraydeque_check(other) &&
+        !PyList_Check(other) && !PyTuple_Check(other)) {
+        if (!PySequence_Check(other))
+            Py_RETURN_NOTIMPLEMENTED;
+        other = list = PySequence_List(other);
+        if (list == NULL)
+            return NULL;
+    }
+    if (arraydeque_check(other))
+        other_deque = (ArrayDequeObject *)other;
+    self_size = deque->size;
+    other_size = other_deque != NULL ? other_deque->size : Py_SIZE(other);
+    if ((op == Py_EQ || op == Py_NE) && self_size != other_size) {
+        Py_XDECREF(list);
+        return PyBool_FromLong(op == Py_NE);
+    }
+
+    /* Find the first index where the items differ */
+    for (i = 0;; i++) {
+        ArrayDequeNeedle needle;
+        int cmp;
+
+        a = arraydeque_compare_item(self, deque, i);
+        b = arraydeque_compare_item(other, other_deque, i);
+        if (a == NULL || b == NULL)
+            break;
+        if (a == b)
+            continue;
+        arraydeque_needle_init(&needle, b);
+        cmp = arraydeque_scalar_equal(a, &needle);
+        if (cmp < 0) {
+            Py_INCREF(a);
+            Py_INCREF(b);
+            cmp = PyObject_RichCompareBool(a, b, Py_EQ);
+            Py_DECREF(a);
+            Py_DECREF(b);
+            if (cmp >= 0 && (deque->size != self_size ||
+                (other_deque != NULL && other_deque->size != other_size))) {
+                PyErr_SetString(PyExc_RuntimeError, "deque mutated during iteration");
+                cmp = -1;
+            }
+            if (cmp < 0) {
+                Py_XDECREF(list);
+                return NULL;
+            }
+        }
+        if (!cmp)
+            break;
+    }
+
+    if (a != NULL && b != NULL && op != Py_EQ && op != Py_NE) {
+        /* The references released after the equality test may have been
+           the last ones if __eq__ replaced the items, so fetch them again,
+           as list does */
+        a = arraydeque_compare_item(self, deque, i);
+        b = arraydeque_compare_item(other, other_deque, i);
+    }
+    if (a == NULL || b == NULL) {
+        /* One sequence is a prefix of the other: compare the lengths, which
+           may have changed if other is a list */
+        if (other_deque == NULL)
+            other_size = Py_SIZE(other);
+        Py_XDECREF(list);
+        Py_RETURN_RICHCOMPARE(self_size, other_size, op);
+    }
+    if (op == Py_EQ || op == Py_NE) {
+        Py_XDECREF(list);
+        return PyBool_FromLong(op == Py_NE);
+    }
+    Py_INCREF(a);
+    Py_INCREF(b);
+    result = PyObject_RichCompare(a, b, op);
+    Py_DECREF(a);
+    Py_DECREF(b);
+    Py_XDECREF(list);
+    return result;
+}
+
+/* __repr__ implementation */
+static PyObject *
+ArrayDeque_repr(ArrayDequeObject *self)
+{
+    PyObject *list = PyList_New(self->size);
+    if (!list)
+        return NULL;
+    for (Py_ssize_t i = 0; i < self->size; i++) {
+        PyObject *item = *arraydeque_slot(self, i);
+        Py_INCREF(item);
+        PyList_SET_ITEM(list, i, item);
+    }
+    PyObject *repr = PyObject_Repr(list);
+    Py_DECREF(list);
+    if (!repr)
+        return NULL;
+    PyObject *result = PyUnicode_FromFormat("ArrayDeque(%U)", repr);
+    Py_DECREF(repr);
+    return result;
+}
+
+/* __str__ implementation: same as __repr__ */
+static PyObject *
+ArrayDeque_str(ArrayDequeObject *self)
+{
+    return ArrayDeque_repr(self);
+}
+
+/* Iterator for ArrayDeque */
+static void
+ArrayDequeIter_dealloc(ArrayDequeIter *it)
+{
+    PyTypeObject *type = Py_TYPE(it);
+
+    Py_XDECREF(it->deque);
+#if ARRAYDEQUE_MAXFREELIST > 0
+    {
+        ArrayDequeState *state = it->module_state;
+        if (state->iter_numfree < ARRAYDEQUE_MAXFREELIST) {
+            state->iter_freelist[state->iter_numfree++] = it;
+            Py_DECREF(type);
+            return;
+        }
+    }
+#endif
+    type->tp_free((PyObject *)it);
+    Py_DECREF(type);
+}
+
+/* Return a new iterator over self, starting at index.  type is one of the
+   iterator types of state; saving state in the iterator spares its
+   deallocator from looking it up again. */
+static PyObject *
+arraydeque_new_iter(ArrayDequeObject *self, ArrayDequeState *state,
+                    PyTypeObject *type, Py_ssize_t index)
+{
+    ArrayDequeIter *it;
+#if ARRAYDEQUE_MAXFREELIST > 0
+    if (state->iter_numfree > 0) {
+        it = state->iter_freelist[--state->iter_numfree];
+        PyObject_Init((PyObject *)it, type);
+    }
+    else
+#endif
+    it = PyObject_New(ArrayDequeIter, type);
+    if (it == NULL)
+        return NULL;
+    Py_INCREF(self);
+    it->deque = self;
+    it->index = index;
+    it->state = self->state;
+    it->module_state = state;
+    return (PyObject *)it;
+}
+
+/* Check that the deque has not changed since iteration started.  Once it
+   has, the iterator raises RuntimeError, like the iterators of
+   collections.deque, and is exhausted from then on. */
+static inline int
+arraydeque_iter_check(ArrayDequeIter *it, Py_ssize_t end)
+{
+    if (it->deque->state == it->state)
+        return 0;
+    it->index = end;
+    it->state = it->deque->state;
+    PyErr_SetString(PyExc_RuntimeError, "deque mutated during iteration");
+    return -1;
+}
+
+static PyObject *
+ArrayDequeIter_next(ArrayDequeIter *it)
+{
+    if (arraydeque_iter_check(it, PY_SSIZE_T_MAX) < 0)
+        return NULL;
+    if (it->index < it->deque->size) {
+        PyObject *item = *arraydeque_slot(it->deque, it->index);
+        it->index++;
+        Py_INCREF(item);
+        return item;
+    }
+    /* End of iteration */
+    return NULL;
+}
+
+static PyObject *
+ArrayDequeIter_length_hint(ArrayDequeIter *it, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t remaining = 0;
+    if (it->deque->state == it->state && it->index < it->deque->size)
+        remaining = it->deque->size - it->index;
+    return PyLong_FromSsize_t(remaining);
+}
+
+/* Pickling support for both iterators: unpickling calls iter() or
+   reversed() on the deque and restores the position with __setstate__. */
+static PyObject *
+arraydeque_iter_reduce(ArrayDequeIter *it, const char *factory)
+{
+    PyObject *builtins = PyEval_GetBuiltins();
+    PyObject *callable = builtins != NULL
+        ? PyDict_GetItemString(builtins, factory) : NULL;
+
+    if (callable == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_Format(PyExc_RuntimeError, "builtin %s() not found", factory);
+        return NULL;
+    }
+    return Py_BuildValue("O(O)n", callable, it->deque, it->index);
+}
+
+static PyObject *
+ArrayDequeIter_reduce(ArrayDequeIter *it, PyObject *Py_UNUSED(ignored))
+{
+    return arraydeque_iter_reduce(it, "iter");
+}
+
+static PyObject *
+ArrayDequeIter_setstate(ArrayDequeIter *it, PyObject *state)
+{
+    Py_ssize_t index = PyLong_AsSsize_t(state);
+    if (index == -1 && PyErr_Occurred())
+        return NULL;
+    it->index = Py_MAX(index, 0);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef ArrayDequeIter_methods[] = {
+    {"__length_hint__", (PyCFunction)ArrayDequeIter_length_hint, METH_NOARGS,
+     "Private method returning an estimate of len(list(it))."},
+    {"__reduce__", (PyCFunction)ArrayDequeIter_reduce, METH_NOARGS,
+     "Return state information for pickling."},
+    {"__setstate__", (PyCFunction)ArrayDequeIter_setstate, METH_O,
+     "Set state information for unpickling."},
+    {NULL}  /* Sentinel */
+};
+
+static PyType_Slot ArrayDequeIter_slots[] = {
+    {Py_tp_dealloc, ArrayDequeIter_dealloc},
+    {Py_tp_iter, PyObject_SelfIter},
+    {Py_tp_iternext, ArrayDequeIter_next},
+    {Py_tp_methods, ArrayDequeIter_methods},
+    {0, NULL}
+};
+
+static PyType_Spec ArrayDequeIter_spec = {
+    .name = "arraydeque.ArrayDequeIter",
+    .basicsize = sizeof(ArrayDequeIter),
+    .flags = Py_TPFLAGS_DEFAULT | ARRAYDEQUE_TPFLAGS_ITER,
+    .slots = ArrayDequeIter_slots,
+};
+
+/* __iter__ method for ArrayDeque: return a new iterator */
+static PyObject *
+ArrayDeque_iter(ArrayDequeObject *self)
+{
+    ArrayDequeState *state = arraydeque_state_of(Py_TYPE(self));
+    return arraydeque_new_iter(self, state, state->iter_type, 0);
+}
+
+/* Reverse iterator for ArrayDeque; shares the iterator struct, dealloc and
+   freelist with ArrayDequeIter */
+static PyObject *
+ArrayDequeRevIter_next(ArrayDequeIter *it)
+{
+    if (arraydeque_iter_check(it, -1) < 0)
+        return NULL;
+    if (it->index >= 0 && it->index < it->deque->size) {
+        PyObject *item = *arraydeque_slot(it->deque, it->index);
+        it->index--;
+        Py_INCREF(item);
+        return item;
+    }
+    /* End of iteration */
+    return NULL;
+}
+
+static PyObject *
+ArrayDequeRevIter_length_hint(ArrayDequeIter *it, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t remaining = 0;
+    if (it->deque->state == it->state && it->index >= 0 &&
+        it->index < it->deque->size)
+        remaining = it->index + 1;
+    return PyLong_FromSsize_t(remaining);
+}
+
+static PyObject *
+ArrayDequeRevIter_reduce(ArrayDequeIter *it, PyObject *Py_UNUSED(ignored))
+{
+    return arraydeque_iter_reduce(it, "reversed");
+}
+
+static PyObject *
+ArrayDequeRevIter_setstate(ArrayDequeIter *it, PyObject *state)
+{
+    Py_ssize_t index = PyLong_AsSsize_t(state);
+    if (index == -1 && PyErr_Occurred())
+        return NULL;
+    it->index = Py_MIN(Py_MAX(index, -1), it->deque->size - 1);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef ArrayDequeRevIter_methods[] = {
+    {"__length_hint__", (PyCFunction)ArrayDequeRevIter_length_hint, METH_NOARGS,
+     "Private method returning an estimate of len(list(it))."},
+    {"__reduce__", (PyCFunction)ArrayDequeRevIter_reduce, METH_NOARGS,
+     "Return state information for pickling."},
+    {"__setstate__", (PyCFunction)ArrayDequeRevIter_setstate, METH_O,
+     "Set state information for unpickling."},
+    {NULL}  /* Sentinel */
+};
+
+static PyType_Slot ArrayDequeRevIter_slots[] = {
+    {Py_tp_dealloc, ArrayDequeIter_dealloc},
+    {Py_tp_iter, PyObject_SelfIter},
+    {Py_tp_iternext, ArrayDequeRevIter_next},
+    {Py_tp_methods, ArrayDequeRevIter_methods},
+    {0, NULL}
+};
+
+static PyType_Spec ArrayDequeRevIter_spec = {
+    .name = "arraydeque.ArrayDequeReverseIter",
+    .basicsize = sizeof(ArrayDequeIter),
+    .flags = Py_TPFLAGS_DEFAULT | ARRAYDEQUE_TPFLAGS_ITER,
+    .slots = ArrayDequeRevIter_slots,
+};
+
+/* __reversed__ method for ArrayDeque: return a new reverse iterator */
+static PyObject *
+ArrayDeque_reversed(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    ArrayDequeState *state = arraydeque_state_of(Py_TYPE(self));
+    return arraydeque_new_iter(self, state, state->reviter_type,
+                               self->size - 1);
+}
+
+/* __new__ method: allocate a new ArrayDeque */
+static PyObject *
+ArrayDeque_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    ArrayDequeObject *self;
+#if ARRAYDEQUE_MAXFREELIST > 0
+    ArrayDequeState *state = arraydeque_state_of(type);
+    if (type == state->deque_type && state->deque_numfree > 0) {
+        self = state->deque_freelist[--state->deque_numfree];
+        PyObject_Init((PyObject *)self, type);
+    }
+    else
+#endif
+    self = (ArrayDequeObject *)type->tp_alloc(type, 0);
+    if (self == NULL)
+        return NULL;
+    self->capacity = ARRAYDEQUE_MIN_CAPACITY;
+    self->size = 0;
+    self->head = 0;
+    self->min_capacity = ARRAYDEQUE_MIN_CAPACITY;
+    self->shrink_limit = 0;
+    self->shrink_threshold = ARRAYDEQUE_SHRINK_THRESHOLD;
+    self->hugepages = 0;
+    self->incremental = 0;
+    self->old_array = NULL;
+    self->old_capacity = 0;
+    self->migrate_lo = 0;
+    self->migrate_hi = 0;
+    self->state = 0;
+    self->array = self->inline_array;
+    /* Default: unbounded deque */
+    self->maxlen = -1;
+    return (PyObject *)self;
+}
+
+/* Apply the arguments of the constructor to a new deque: set maxlen and
+   the options, reserve capacity and append the items of iterable.
+   Returns 0 on success and -1 on failure. */
+static int
+arraydeque_configure(ArrayDequeObject *self, PyObject *iterable,
+                     PyObject *maxlen_obj, Py_ssize_t capacity, int hugepages,
+                     int incremental)
+{
+    if (capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be non-negative");
+        return -1;
+    }
+
+    if (maxlen_obj == Py_None) {
+        self->maxlen = -1;
+    } else {
+        Py_ssize_t m = PyLong_AsSsize_t(maxlen_obj);
+        if (m < 0) {
+            PyErr_SetString(PyExc_ValueError, "maxlen must be a non-negative integer");
+            return -1;
+        }
+        self->maxlen = m;
+    }
+
+    self->hugepages = hugepages;
+    self->incremental = incremental;
+    arraydeque_update_shrink_limit(self);
+    if (capacity > 0 && arraydeque_reserve(self, capacity) < 0)
+        return -1;
+
+    if (iterable && iterable != Py_None) {
+        if (arraydeque_extend(self, iterable, 0) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* __init__ method: optionally initialize the deque with an iterable and a maxlen.
+   Signature: ArrayDeque([iterable[, maxlen]], *, capacity=0, hugepages=False,
+                         incremental=False)
+   If maxlen is provided and not None, it must be a non-negative integer.
+   When iterable is longer than maxlen, only the rightmost elements are retained.
+   A non-zero capacity reserves room for that many items up front.
+   With hugepages, large backing arrays ask for transparent huge pages.
+   With incremental, growth spreads the copy over later operations and the
+   array is not shrunk automatically.
+*/
+static int
+ArrayDeque_init(ArrayDequeObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"iterable", "maxlen", "capacity", "hugepages",
+                             "incremental", NULL};
+    PyObject *iterable = NULL;
+    PyObject *maxlen_obj = Py_None;
+    Py_ssize_t capacity = 0;
+    int hugepages = 0;
+    int incremental = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO$npp:__init__", kwlist,
+                                     &iterable, &maxlen_obj, &capacity,
+                                     &hugepages, &incremental))
+        return -1;
+    return arraydeque_configure(self, iterable, maxlen_obj, capacity,
+                                hugepages, incremental);
+}
+
+/* Vectorcall constructor, used from Python 3.9 on.  ArrayDeque() and calls
+   such as ArrayDeque(maxlen=N) then skip packing the arguments into a tuple
+   and a dict for tp_new and tp_init.  tp_vectorcall is not inherited, so
+   subclasses still go through those. */
+static PyObject *
+ArrayDeque_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf,
+                      PyObject *kwnames)
+{
+    static const char *const kwlist[] = {"iterable", "maxlen", "capacity",
+                                         "hugepages", "incremental"};
+    enum { NUM_KEYWORDS = 5 };
+    PyObject *values[NUM_KEYWORDS] = {NULL, NULL, NULL, NULL, NULL};
+    Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+    Py_ssize_t capacity = 0;
+    int hugepages = 0, incremental = 0;
+    PyObject *self;
+
+    assert((PyTypeObject *)type ==
+           arraydeque_state_of((PyTypeObject *)type)->deque_type);
+    if (nargs > 2) {
+        PyErr_Format(PyExc_TypeError,
+                     "__init__() takes at most 2 positional arguments (%zd given)",
+                     nargs);
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < nargs; i++)
+        values[i] = args[i];
+    if (kwnames != NULL) {
+        for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(kwnames); i++) {
+            PyObject *name = PyTuple_GET_ITEM(kwnames, i);
+            int k = 0;
+            while (k < NUM_KEYWORDS &&
+                   PyUnicode_CompareWithASCIIString(name, kwlist[k]) != 0)
+                k++;
+            if (k == NUM_KEYWORDS) {
+                PyErr_Format(PyExc_TypeError,
+                             "'%U' is an invalid keyword argument for __init__()",
+                             name);
+                return NULL;
+            }
+            if (values[k] != NULL) {
+                PyErr_Format(PyExc_TypeError,
+                             "argument for __init__() given by name ('%s') "
+                             "and position (%d)", kwlist[k], k + 1);
+                return NULL;
+            }
+            values[k] = args[nargs + i];
+        }
+    }
+    if (values[2] != NULL && arraydeque_ssize_arg(values[2], &capacity) < 0)
+        return NULL;
+    if (values[3] != NULL && (hugepages = PyObject_IsTrue(values[3])) < 0)
+        return NULL;
+    if (values[4] != NULL && (incremental = PyObject_IsTrue(values[4])) < 0)
+        return NULL;
+
+    self = ArrayDeque_new((PyTypeObject *)type, NULL, NULL);
+    if (self == NULL)
+        return NULL;
+    if (arraydeque_configure((ArrayDequeObject *)self, values[0],
+                             values[1] != NULL ? values[1] : Py_None,
+                             capacity, hugepages, incremental) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return self;
+}
+
+/* __dealloc__ method: free all references and the array */
+static void
+ArrayDeque_dealloc(ArrayDequeObject *self)
+{
+    PyTypeObject *type = Py_TYPE(self);
+
+    arraydeque_settle(self);
+    for (Py_ssize_t i = 0; i < self->size; i++) {
+        Py_DECREF(self->array[arraydeque_pos(self, i)]);
+    }
+    arraydeque_array_free(self, self->array, self->capacity);
+#if ARRAYDEQUE_MAXFREELIST > 0
+    {
+        ArrayDequeState *state = arraydeque_state_of(type);
+        if (type == state->deque_type &&
+            state->deque_numfree < ARRAYDEQUE_MAXFREELIST) {
+            state->deque_freelist[state->deque_numfree++] = self;
+            Py_DECREF(type);
+            return;
+        }
+    }
+#endif
+    type->tp_free((PyObject *)self);
+    /* Heap types are owned by their instances, including subclass ones */
+    Py_DECREF(type);
 }
 
-/* Method: count(value)
-   Count the number of occurrences of value.
-*/
+/* Getter for the maxlen attribute.
+   Returns None if unbounded; otherwise a Python integer. */
 static PyObject *
-ArrayDeque_count(ArrayDequeObject *self, PyObject *value)
+ArrayDeque_get_maxlen(ArrayDequeObject *self, void *closure)
 {
-    Py_ssize_t count = 0;
-    for (Py_ssize_t i = self->head; i < self->tail; i++) {
-        int cmp = PyObject_RichCompareBool(self->array[i], value, Py_EQ);
-        if (cmp < 0)
-            return NULL;
-        if (cmp)
-            count++;
-    }
-    return PyLong_FromSsize_t(count);
+    if (self->maxlen < 0)
+        Py_RETURN_NONE;
+    return PyLong_FromSsize_t(self->maxlen);
 }
 
-/* Sequence protocol: __len__ support */
-static Py_ssize_t
-ArrayDeque_length(ArrayDequeObject *self)
+/* Getter for the capacity attribute: the number of allocated slots. */
+static PyObject *
+ArrayDeque_get_capacity(ArrayDequeObject *self, void *closure)
 {
-    return self->size;
+    return PyLong_FromSsize_t(self->capacity);
 }
 
-/* Sequence protocol: __getitem__ support (only for integer indices) */
+/* Getter for the hugepages attribute. */
 static PyObject *
-ArrayDeque_seq_getitem(ArrayDequeObject *self, Py_ssize_t index)
+ArrayDeque_get_hugepages(ArrayDequeObject *self, void *closure)
 {
-    if (index < 0)
-        index += self->size;
-    if (index < 0 || index >= self->size) {
-        PyErr_SetString(PyExc_IndexError, "deque index out of range");
-        return NULL;
-    }
-    PyObject *item = self->array[self->head + index];
-    Py_INCREF(item);
-    return item;
+    return PyBool_FromLong(self->hugepages);
 }
 
-/* Mapping protocol: __getitem__ support (same as sequence) */
+/* Getter for the incremental attribute. */
 static PyObject *
-ArrayDeque_getitem(ArrayDequeObject *self, PyObject *key)
+ArrayDeque_get_incremental(ArrayDequeObject *self, void *closure)
 {
-    if (!PyLong_Check(key)) {
-        PyErr_SetString(PyExc_TypeError, "deque indices must be integers");
-        return NULL;
-    }
-    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
-    if (index == -1 && PyErr_Occurred())
-        return NULL;
-    return ArrayDeque_seq_getitem(self, index);
+    return PyBool_FromLong(self->incremental);
+}
+
+/* Getter and setter for the shrink_threshold attribute.
+   The backing array is halved when its occupancy drops below this ratio;
+   zero disables automatic shrinking.  Values must be below 0.5 so that a
+   freshly shrunk array is never full. */
+static PyObject *
+ArrayDeque_get_shrink_threshold(ArrayDequeObject *self, void *closure)
+{
+    return PyFloat_FromDouble(self->shrink_threshold);
 }
 
-/* Sequence protocol: __setitem__ support (only for integer indices) */
 static int
-ArrayDeque_seq_setitem(ArrayDequeObject *self, Py_ssize_t index, PyObject *value)
+ArrayDeque_set_shrink_threshold(ArrayDequeObject *self, PyObject *value,
+                                void *closure)
 {
-    /* If value is NULL, this signals deletion which is not supported. */
+    double threshold;
+
     if (value == NULL) {
-        PyErr_SetString(PyExc_TypeError, "deque deletion not supported");
+        PyErr_SetString(PyExc_TypeError, "cannot delete shrink_threshold");
         return -1;
     }
-    if (index < 0)
-        index += self->size;
-    if (index < 0 || index >= self->size) {
-        PyErr_SetString(PyExc_IndexError, "deque assignment index out of range");
+    threshold = PyFloat_AsDouble(value);
+    if (threshold == -1.0 && PyErr_Occurred())
+        return -1;
+    if (!(threshold >= 0.0 && threshold < 0.5)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "shrink_threshold must be at least 0.0 and below 0.5");
         return -1;
     }
-    PyObject *old = self->array[self->head + index];
-    Py_INCREF(value);
-    self->array[self->head + index] = value;
-    Py_DECREF(old);
+    self->shrink_threshold = threshold;
+    arraydeque_update_shrink_limit(self);
     return 0;
 }
 
-/* Mapping protocol: __setitem__ support */
-static int
-ArrayDeque_setitem(ArrayDequeObject *self, PyObject *key, PyObject *value)
+/* Give a copy the settings of the deque it was copied from. */
+static void
+arraydeque_copy_settings(ArrayDequeObject *copy, ArrayDequeObject *self)
 {
-    if (!PyLong_Check(key)) {
-        PyErr_SetString(PyExc_TypeError, "deque indices must be integers");
-        return -1;
+    copy->shrink_threshold = self->shrink_threshold;
+    copy->hugepages = self->hugepages;
+    copy->incremental = self->incremental;
+    arraydeque_update_shrink_limit(copy);
+}
+
+/* Return a new empty deque of the same type, maxlen and settings as self.
+   Subclasses are created by calling the type with an empty iterable and the
+   maxlen. */
+static ArrayDequeObject *
+arraydeque_new_empty(ArrayDequeObject *self)
+{
+    ArrayDequeObject *copy;
+
+    if (arraydeque_check_exact(self)) {
+        copy = (ArrayDequeObject *)ArrayDeque_new(Py_TYPE(self), NULL, NULL);
+        if (copy == NULL)
+            return NULL;
+        copy->maxlen = self->maxlen;
     }
-    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
-    if (index == -1 && PyErr_Occurred())
-        return -1;
-    return ArrayDeque_seq_setitem(self, index, value);
+    else {
+        PyObject *result = self->maxlen < 0
+            ? PyObject_CallFunction((PyObject *)Py_TYPE(self), "()O", Py_None)
+            : PyObject_CallFunction((PyObject *)Py_TYPE(self), "()n", self->maxlen);
+        if (result == NULL)
+            return NULL;
+        if (!arraydeque_check(result)) {
+            PyErr_Format(PyExc_TypeError,
+                         "%.200s() must return an ArrayDeque, not %.200s",
+                         Py_TYPE(self)->tp_name, Py_TYPE(result)->tp_name);
+            Py_DECREF(result);
+            return NULL;
+        }
+        copy = (ArrayDequeObject *)result;
+    }
+    arraydeque_copy_settings(copy, self);
+    return copy;
 }
 
-/* __contains__ implementation */
+/* Grow the backing array of a deque so it holds n items without further
+   reallocation, unlike arraydeque_reserve without keeping the capacity.
+   Returns 0 on success and -1 on failure. */
 static int
-ArrayDeque_contains(ArrayDequeObject *self, PyObject *value)
+arraydeque_make_room(ArrayDequeObject *self, Py_ssize_t n)
 {
-    for (Py_ssize_t i = self->head; i < self->tail; i++) {
-        int cmp = PyObject_RichCompareBool(self->array[i], value, Py_EQ);
-        if (cmp < 0)
-            return -1;
-        if (cmp)
-            return 1;
+    Py_ssize_t new_capacity;
+
+    if (n <= self->capacity)
+        return 0;
+    new_capacity = arraydeque_round_capacity(n);
+    if (new_capacity < 0) {
+        PyErr_NoMemory();
+        return -1;
     }
-    return 0;
+    return arraydeque_grow(self, new_capacity);
 }
 
-/* Rich comparison support: only equality and inequality are implemented */
+/* Method: copy()
+   Return a shallow copy.  Exact deques get an array sized for the items,
+   filled with one memcpy; subclasses are rebuilt through their constructor
+   as type(d)(d, maxlen). */
 static PyObject *
-ArrayDeque_richcompare(PyObject *self, PyObject *other, int op)
+ArrayDeque_copy(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
 {
-    if (op != Py_EQ && op != Py_NE) {
-        Py_RETURN_NOTIMPLEMENTED;
+    ArrayDequeObject *copy;
+    Py_ssize_t n;
+
+    if (!arraydeque_check_exact(self)) {
+        PyObject *result = self->maxlen < 0
+            ? PyObject_CallFunction((PyObject *)Py_TYPE(self), "OO", self, Py_None)
+            : PyObject_CallFunction((PyObject *)Py_TYPE(self), "On", self, self->maxlen);
+        if (result != NULL && arraydeque_check(result))
+            arraydeque_copy_settings((ArrayDequeObject *)result, self);
+        return result;
     }
-    PyObject *self_list = PySequence_List(self);
-    PyObject *other_list = PySequence_List(other);
-    if (!self_list || !other_list) {
-        Py_XDECREF(self_list);
-        Py_XDECREF(other_list);
+    copy = arraydeque_new_empty(self);
+    if (copy == NULL)
         return NULL;
-    }
-    int equal = PyObject_RichCompareBool(self_list, other_list, Py_EQ);
-    Py_DECREF(self_list);
-    Py_DECREF(other_list);
-    if (equal < 0)
+    n = self->size;
+    if (arraydeque_make_room(copy, n) < 0) {
+        Py_DECREF(copy);
         return NULL;
-    if (op == Py_EQ) {
-        if (equal) {
-            Py_INCREF(Py_True);
-            return Py_True;
-        } else {
-            Py_INCREF(Py_False);
-            return Py_False;
-        }
-    } else {
-        if (equal) {
-            Py_INCREF(Py_False);
-            return Py_False;
-        } else {
-            Py_INCREF(Py_True);
-            return Py_True;
-        }
     }
+    arraydeque_settle(self);
+    arraydeque_copy_out(self, 0, n, copy->array);
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_INCREF(copy->array[i]);
+    copy->size = n;
+    return (PyObject *)copy;
 }
 
-/* __repr__ implementation */
+/* Method: __deepcopy__(memo)
+   Return a deep copy, storing copy.deepcopy() of each item straight into an
+   array sized for all of them.  The copy is entered in memo first, so items
+   that refer back to the deque get the copy. */
 static PyObject *
-ArrayDeque_repr(ArrayDequeObject *self)
+ArrayDeque_deepcopy(ArrayDequeObject *self, PyObject *memo)
 {
-    PyObject *list = PyList_New(self->size);
-    if (!list)
+    PyObject *copy_module, *deepcopy, *id;
+    ArrayDequeObject *copy;
+    Py_ssize_t n;
+
+    copy_module = PyImport_ImportModule("copy");
+    if (copy_module == NULL)
         return NULL;
-    for (Py_ssize_t i = 0; i < self->size; i++) {
-        PyObject *item = self->array[self->head + i];
+    deepcopy = PyObject_GetAttrString(copy_module, "deepcopy");
+    Py_DECREF(copy_module);
+    if (deepcopy == NULL)
+        return NULL;
+    copy = arraydeque_new_empty(self);
+    if (copy == NULL || arraydeque_make_room(copy, self->size) < 0)
+        goto error;
+    if (memo != Py_None) {
+        id = PyLong_FromVoidPtr(self);
+        if (id == NULL || PyObject_SetItem(memo, id, (PyObject *)copy) < 0) {
+            Py_XDECREF(id);
+            goto error;
+        }
+        Py_DECREF(id);
+    }
+    n = self->size;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = *arraydeque_slot(self, i);
+        PyObject *item_copy;
+        int rc;
+
         Py_INCREF(item);
-        PyList_SET_ITEM(list, i, item);
+        item_copy = PyObject_CallFunctionObjArgs(deepcopy, item, memo, NULL);
+        Py_DECREF(item);
+        if (item_copy == NULL)
+            goto error;
+        if (self->size != n) {
+            Py_DECREF(item_copy);
+            PyErr_SetString(PyExc_RuntimeError, "deque mutated during iteration");
+            goto error;
+        }
+        /* The copy is reachable through memo, so append rather than store */
+        rc = arraydeque_append(copy, item_copy);
+        Py_DECREF(item_copy);
+        if (rc < 0)
+            goto error;
     }
-    PyObject *repr = PyObject_Repr(list);
-    Py_DECREF(list);
-    if (!repr)
-        return NULL;
-    PyObject *result = PyUnicode_FromFormat("ArrayDeque(%U)", repr);
-    Py_DECREF(repr);
-    return result;
+    Py_DECREF(deepcopy);
+    return (PyObject *)copy;
+
+error:
+    Py_DECREF(deepcopy);
+    Py_XDECREF(copy);
+    return NULL;
 }
 
-/* __str__ implementation: same as __repr__ */
-static PyObject *
-ArrayDeque_str(ArrayDequeObject *self)
+/* Copy the pointers in the n slots starting at logical index src to the n
+   slots starting at logical index dst, which must not overlap them.  No
+   reference counts change and no migration may be pending. */
+static void
+arraydeque_copy_within(ArrayDequeObject *self, Py_ssize_t src, Py_ssize_t dst,
+                       Py_ssize_t n)
 {
-    return ArrayDeque_repr(self);
+    while (n > 0) {
+        Py_ssize_t s = arraydeque_pos(self, src);
+        Py_ssize_t d = arraydeque_pos(self, dst);
+        Py_ssize_t chunk = Py_MIN(n, self->capacity - Py_MAX(s, d));
+        memcpy(self->array + d, self->array + s, chunk * sizeof(PyObject *));
+        src += chunk;
+        dst += chunk;
+        n -= chunk;
+    }
 }
 
-/* Iterator for ArrayDeque */
+/* Return the number of items left by repeating the non-empty deque n > 0
+   times, after truncation to maxlen, or -1 with MemoryError set if that does
+   not fit in memory. */
+static Py_ssize_t
+arraydeque_repeat_size(ArrayDequeObject *self, Py_ssize_t n)
+{
+    Py_ssize_t total;
+
+    if (n > PY_SSIZE_T_MAX / self->size)
+        total = PY_SSIZE_T_MAX;
+    else
+        total = self->size * n;
+    if (self->maxlen >= 0 && total > self->maxlen)
+        return self->maxlen;
+    if (arraydeque_round_capacity(total) < 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return total;
+}
+
+/* Fill the slots from the current size up to m with repetitions of the
+   items, copying the whole filled run at each step so the number of copies
+   is logarithmic, then take the new references in one pass.  The capacity
+   must be at least m and no migration may be pending. */
 static void
-ArrayDequeIter_dealloc(ArrayDequeIter *it)
+arraydeque_repeat_fill(ArrayDequeObject *self, Py_ssize_t m)
 {
-    Py_XDECREF(it->deque);
-    Py_TYPE(it)->tp_free((PyObject *)it);
+    Py_ssize_t filled = self->size;
+
+    while (filled < m) {
+        Py_ssize_t chunk = Py_MIN(filled, m - filled);
+        arraydeque_copy_within(self, 0, filled, chunk);
+        filled += chunk;
+    }
+    for (Py_ssize_t i = self->size; i < m; i++)
+        Py_INCREF(self->array[arraydeque_pos(self, i)]);
+    self->size = m;
+    self->state++;
 }
 
+/* Sequence protocol: d + other, for another deque.  The result keeps the
+   maxlen of d, and only the items that survive it are copied. */
 static PyObject *
-ArrayDequeIter_next(ArrayDequeIter *it)
+ArrayDeque_concat(ArrayDequeObject *self, PyObject *other)
 {
-    if (it->index < it->deque->size) {
-        PyObject *item = it->deque->array[it->deque->head + it->index];
-        it->index++;
-        Py_INCREF(item);
-        return item;
+    ArrayDequeObject *copy, *right;
+    Py_ssize_t keep_left, keep_right;
+
+    if (!arraydeque_check(other)) {
+        PyErr_Format(PyExc_TypeError,
+                     "can only concatenate ArrayDeque (not \"%.200s\") to ArrayDeque",
+                     Py_TYPE(other)->tp_name);
+        return NULL;
     }
-    /* End of iteration */
-    return NULL;
+    if (!arraydeque_check_exact(self)) {
+        PyObject *result = ArrayDeque_copy(self, NULL);
+        if (result != NULL &&
+            arraydeque_extend((ArrayDequeObject *)result, other, 0) < 0)
+            Py_CLEAR(result);
+        return result;
+    }
+    copy = arraydeque_new_empty(self);
+    if (copy == NULL)
+        return NULL;
+    right = (ArrayDequeObject *)other;
+    keep_left = self->size;
+    keep_right = right->size;
+    if (self->maxlen >= 0) {
+        keep_right = Py_MIN(keep_right, self->maxlen);
+        keep_left = Py_MIN(keep_left, self->maxlen - keep_right);
+    }
+    if (keep_left > PY_SSIZE_T_MAX - keep_right ||
+        arraydeque_make_room(copy, keep_left + keep_right) < 0) {
+        if (!PyErr_Occurred())
+            PyErr_NoMemory();
+        Py_DECREF(copy);
+        return NULL;
+    }
+    arraydeque_settle(self);
+    arraydeque_settle(right);
+    arraydeque_copy_out(self, self->size - keep_left, keep_left, copy->array);
+    arraydeque_copy_out(right, right->size - keep_right, keep_right,
+                        copy->array + keep_left);
+    copy->size = keep_left + keep_right;
+    for (Py_ssize_t i = 0; i < copy->size; i++)
+        Py_INCREF(copy->array[i]);
+    return (PyObject *)copy;
 }
 
-static PyTypeObject ArrayDequeIter_Type = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "arraydeque.ArrayDequeIter",
-    .tp_basicsize = sizeof(ArrayDequeIter),
-    .tp_itemsize = 0,
-    .tp_dealloc = (destructor)ArrayDequeIter_dealloc,
-    .tp_flags = Py_TPFLAGS_DEFAULT,
-    .tp_iter = PyObject_SelfIter,
-    .tp_iternext = (iternextfunc)ArrayDequeIter_next,
-};
-
-/* __iter__ method for ArrayDeque: return a new iterator */
+/* Sequence protocol: d += iterable, the same as d.extend(iterable). */
 static PyObject *
-ArrayDeque_iter(ArrayDequeObject *self)
+ArrayDeque_inplace_concat(ArrayDequeObject *self, PyObject *other)
 {
-    ArrayDequeIter *it;
-    it = PyObject_New(ArrayDequeIter, &ArrayDequeIter_Type);
-    if (it == NULL)
+    if (arraydeque_extend(self, other, 0) < 0)
         return NULL;
     Py_INCREF(self);
-    it->deque = self;
-    it->index = 0;
-    return (PyObject *)it;
+    return (PyObject *)self;
 }
 
-/* __new__ method: allocate a new ArrayDeque */
+/* Sequence protocol: d *= n.  The repeated items are truncated to maxlen
+   before anything is copied: the items that would be discarded from the
+   left are skipped by rotating the originals, and the array is grown once
+   before the repetitions are filled in.  n <= 0 clears the deque. */
 static PyObject *
-ArrayDeque_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+ArrayDeque_inplace_repeat(ArrayDequeObject *self, Py_ssize_t n)
 {
-    ArrayDequeObject *self;
-    self = (ArrayDequeObject *)type->tp_alloc(type, 0);
-    if (self == NULL)
-        return NULL;
-    self->capacity = 8;  /* initial capacity */
-    self->size = 0;
-    /* Start in the middle so that both ends have some space */
-    self->head = self->capacity / 2;
-    self->tail = self->head;
-    self->array = PyMem_New(PyObject *, self->capacity);
-    if (self->array == NULL) {
-        Py_DECREF(self);
-        PyErr_NoMemory();
-        return NULL;
+    if (n <= 0) {
+        PyObject *result = ArrayDeque_clear(self, NULL);
+        if (result == NULL)
+            return NULL;
+        Py_DECREF(result);
     }
-    for (Py_ssize_t i = 0; i < self->capacity; i++) {
-        self->array[i] = NULL;
+    else if (self->size > 0) {
+        Py_ssize_t m = arraydeque_repeat_size(self, n);
+        if (m < 0)
+            return NULL;
+        if (m < self->size) {
+            /* A deque over its maxlen keeps only its last m items, even for
+               n == 1; they are detached first and released once the deque
+               is consistent */
+            PyObject *evicted = arraydeque_pop_many(self, self->size - m, 1);
+            if (evicted == NULL)
+                return NULL;
+            Py_DECREF(evicted);
+        }
+        else if (n > 1) {
+            if (arraydeque_make_room(self, m) < 0)
+                return NULL;
+            /* Start at the first item that survives truncation */
+            arraydeque_rotate(self, m % self->size);
+            arraydeque_settle(self);
+            arraydeque_repeat_fill(self, m);
+        }
     }
-    /* Default: unbounded deque */
-    self->maxlen = -1;
+    Py_INCREF(self);
     return (PyObject *)self;
 }
 
-/* __init__ method: optionally initialize the deque with an iterable and a maxlen.
-   Signature: ArrayDeque([iterable[, maxlen]])
-   If maxlen is provided and not None, it must be a non-negative integer.
-   When iterable is longer than maxlen, only the rightmost elements are retained.
-*/
-static int
-ArrayDeque_init(ArrayDequeObject *self, PyObject *args, PyObject *kwds)
+/* Sequence protocol: d * n, a new deque with the same maxlen. */
+static PyObject *
+ArrayDeque_repeat(ArrayDequeObject *self, Py_ssize_t n)
 {
-    static char *kwlist[] = {"iterable", "maxlen", NULL};
-    PyObject *iterable = NULL;
-    PyObject *maxlen_obj = Py_None;
-
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:__init__", kwlist,
-                                     &iterable, &maxlen_obj))
-        return -1;
+    ArrayDequeObject *copy;
+    Py_ssize_t m, offset;
 
-    if (maxlen_obj == Py_None) {
-        self->maxlen = -1;
-    } else {
-        Py_ssize_t m = PyLong_AsSsize_t(maxlen_obj);
-        if (m < 0) {
-            PyErr_SetString(PyExc_ValueError, "maxlen must be a non-negative integer");
-            return -1;
-        }
-        self->maxlen = m;
+    if (!arraydeque_check_exact(self)) {
+        PyObject *result, *copied = ArrayDeque_copy(self, NULL);
+        if (copied == NULL)
+            return NULL;
+        result = PySequence_InPlaceRepeat(copied, n);
+        Py_DECREF(copied);
+        return result;
     }
-
-    if (iterable && iterable != Py_None) {
-        PyObject *iterator = PyObject_GetIter(iterable);
-        if (iterator == NULL)
-            return -1;
-        PyObject *item;
-        while ((item = PyIter_Next(iterator)) != NULL) {
-            if (ArrayDeque_append(self, item) == NULL) {
-                Py_DECREF(item);
-                Py_DECREF(iterator);
-                return -1;
-            }
-            Py_DECREF(item);
-        }
-        Py_DECREF(iterator);
-        if (PyErr_Occurred())
-            return -1;
+    copy = arraydeque_new_empty(self);
+    if (copy == NULL)
+        return NULL;
+    if (n <= 0 || self->size == 0)
+        return (PyObject *)copy;
+    m = arraydeque_repeat_size(self, n);
+    if (m < 0 || arraydeque_make_room(copy, m) < 0) {
+        Py_DECREF(copy);
+        return NULL;
     }
-    return 0;
-}
-
-/* __dealloc__ method: free all references and the array */
-static void
-ArrayDeque_dealloc(ArrayDequeObject *self)
-{
-    for (Py_ssize_t i = self->head; i < self->tail; i++) {
-        Py_XDECREF(self->array[i]);
+    arraydeque_settle(self);
+    if (m < self->size) {
+        /* A deque over its maxlen keeps only its last m items */
+        arraydeque_copy_out(self, self->size - m, m, copy->array);
+        copy->size = m;
     }
-    PyMem_Free(self->array);
-    Py_TYPE(self)->tp_free((PyObject *)self);
-}
-
-/* Getter for the maxlen attribute.
-   Returns None if unbounded; otherwise a Python integer. */
-static PyObject *
-ArrayDeque_get_maxlen(ArrayDequeObject *self, void *closure)
-{
-    if (self->maxlen < 0)
-        Py_RETURN_NONE;
-    return PyLong_FromSsize_t(self->maxlen);
+    else {
+        /* Copy the originals starting at the first item that survives
+           truncation, then double them up to m */
+        offset = (self->size - m % self->size) % self->size;
+        arraydeque_copy_out(self, offset, self->size - offset, copy->array);
+        arraydeque_copy_out(self, 0, offset, copy->array + self->size - offset);
+        copy->size = self->size;
+    }
+    for (Py_ssize_t i = 0; i < copy->size; i++)
+        Py_INCREF(copy->array[i]);
+    arraydeque_repeat_fill(copy, m);
+    return (PyObject *)copy;
 }
 
 /* __reduce__ for pickling */
@@ -601,7 +3395,7 @@ ArrayDeque_reduce(ArrayDequeObject *self)
     if (!list)
         return NULL;
     for (Py_ssize_t i = 0; i < self->size; i++) {
-        PyObject *item = self->array[self->head + i];
+        PyObject *item = *arraydeque_slot(self, i);
         Py_INCREF(item);
         PyList_SET_ITEM(list, i, item);
     }
@@ -624,10 +3418,31 @@ ArrayDeque_reduce(ArrayDequeObject *self)
     return Py_BuildValue("OO", Py_TYPE(self), args);
 }
 
+/* __sizeof__: the object plus any backing array outside of it */
+static PyObject *
+ArrayDeque_sizeof(ArrayDequeObject *self, PyObject *Py_UNUSED(ignored))
+{
+    Py_ssize_t res = Py_TYPE(self)->tp_basicsize;
+    if (self->array != self->inline_array)
+        res += self->capacity * (Py_ssize_t)sizeof(PyObject *);
+    if (self->old_array != NULL && self->old_array != self->inline_array)
+        res += self->old_capacity * (Py_ssize_t)sizeof(PyObject *);
+    return PyLong_FromSsize_t(res);
+}
+
 /* Get/Set definitions */
 static PyGetSetDef ArrayDeque_getsetters[] = {
     {"maxlen", (getter)ArrayDeque_get_maxlen, NULL,
      "maximum length (read-only); None if unbounded", NULL},
+    {"capacity", (getter)ArrayDeque_get_capacity, NULL,
+     "number of allocated slots (read-only)", NULL},
+    {"hugepages", (getter)ArrayDeque_get_hugepages, NULL,
+     "whether large arrays use transparent huge pages (read-only)", NULL},
+    {"incremental", (getter)ArrayDeque_get_incremental, NULL,
+     "whether growth migrates items a few at a time (read-only)", NULL},
+    {"shrink_threshold", (getter)ArrayDeque_get_shrink_threshold,
+     (setter)ArrayDeque_set_shrink_threshold,
+     "occupancy ratio below which memory is given back; 0 disables", NULL},
     {NULL}  /* Sentinel */
 };
 
@@ -641,63 +3456,165 @@ static PyMethodDef ArrayDeque_methods[] = {
      "Remove and return an element from the right end"},
     {"popleft",     (PyCFunction)ArrayDeque_popleft,     METH_NOARGS,
      "Remove and return an element from the left end"},
+    {"popleftn",    (PyCFunction)ArrayDeque_popleftn,    METH_O,
+     "Remove and return up to k elements from the left end as a list"},
+    {"popn",        (PyCFunction)ArrayDeque_popn,        METH_O,
+     "Remove and return up to k elements from the right end as a list"},
+    {"drain",       (PyCFunction)ArrayDeque_drain,       METH_NOARGS,
+     "Remove and return all elements as a list"},
     {"clear",       (PyCFunction)ArrayDeque_clear,       METH_NOARGS,
      "Remove all elements"},
+    {"reserve",     (PyCFunction)ArrayDeque_reserve,     METH_O,
+     "Reserve capacity for at least n elements"},
+    {"shrink_to_fit", (PyCFunction)ArrayDeque_shrink_to_fit, METH_NOARGS,
+     "Release unused capacity and drop any reservation"},
     {"extend",      (PyCFunction)ArrayDeque_extend,      METH_O,
      "Extend the right side with elements from an iterable"},
     {"extendleft",  (PyCFunction)ArrayDeque_extendleft,  METH_O,
      "Extend the left side with elements from an iterable"},
-    {"rotate",      (PyCFunction)ArrayDeque_rotate,      METH_VARARGS,
+    {"rotate",      (PyCFunction)(void(*)(void))ArrayDeque_rotate,
+     METH_FASTCALL,
      "Rotate the deque n steps to the right (default 1). If n is negative, rotate left."},
+    {"reverse",     (PyCFunction)ArrayDeque_reverse,     METH_NOARGS,
+     "Reverse the elements in place"},
+    {"sort",        (PyCFunction)(void(*)(void))ArrayDeque_sort,
+     METH_VARARGS | METH_KEYWORDS,
+     "Sort the elements in place; accepts key and reverse like list.sort"},
+    {"insert",      (PyCFunction)(void(*)(void))ArrayDeque_insert,
+     METH_FASTCALL,
+     "Insert value before position i"},
     {"remove",      (PyCFunction)ArrayDeque_remove,      METH_O,
      "Remove the first occurrence of value"},
+    {"remove_all",  (PyCFunction)ArrayDeque_remove_all,  METH_O,
+     "Remove every occurrence of value and return the number removed"},
+    {"filter_inplace", (PyCFunction)ArrayDeque_filter_inplace, METH_O,
+     "Keep only the elements for which predicate is true; return the number removed"},
+    {"index",       (PyCFunction)(void(*)(void))ArrayDeque_index,
+     METH_FASTCALL,
+     "Return the index of the first occurrence of value"},
+    {"rindex",      (PyCFunction)(void(*)(void))ArrayDeque_rindex,
+     METH_FASTCALL,
+     "Return the index of the last occurrence of value"},
     {"count",       (PyCFunction)ArrayDeque_count,       METH_O,
      "Count the number of occurrences of value"},
+    {"__reversed__", (PyCFunction)ArrayDeque_reversed,   METH_NOARGS,
+     "Return a reverse iterator over the deque"},
+    {"copy",        (PyCFunction)ArrayDeque_copy,        METH_NOARGS,
+     "Return a shallow copy of the deque"},
+    {"__copy__",    (PyCFunction)ArrayDeque_copy,        METH_NOARGS,
+     "Return a shallow copy of the deque"},
+    {"__deepcopy__", (PyCFunction)ArrayDeque_deepcopy,   METH_O,
+     "Return a deep copy of the deque"},
     {"__reduce__",  (PyCFunction)ArrayDeque_reduce,      METH_NOARGS,
      "Helper for pickle."},
+    {"__sizeof__",  (PyCFunction)ArrayDeque_sizeof,      METH_NOARGS,
+     "Size of the deque in memory, in bytes"},
     {NULL}  /* Sentinel */
 };
 
-/* Define sequence methods (supporting __len__, __getitem__, __setitem__, and __contains__) */
-static PySequenceMethods ArrayDeque_as_sequence = {
-    (lenfunc)ArrayDeque_length,               /* sq_length */
-    0,                                        /* sq_concat */
-    0,                                        /* sq_repeat */
-    (ssizeargfunc)ArrayDeque_seq_getitem,       /* sq_item */
-    0,                                        /* sq_slice */
-    (ssizeobjargproc)ArrayDeque_seq_setitem,    /* sq_ass_item */
-    0,                                        /* sq_ass_slice */
-    (objobjproc)ArrayDeque_contains,            /* sq_contains */
-    0,                                        /* sq_inplace_concat */
-    0                                         /* sq_inplace_repeat */
+/* Type definition for ArrayDeque */
+static PyType_Slot ArrayDeque_slots[] = {
+    {Py_tp_doc, "Array-backed deque with optional bounded length"},
+    {Py_tp_dealloc, ArrayDeque_dealloc},
+    {Py_tp_new, ArrayDeque_new},
+    {Py_tp_init, ArrayDeque_init},
+    {Py_tp_iter, ArrayDeque_iter},
+    {Py_tp_methods, ArrayDeque_methods},
+    {Py_tp_getset, ArrayDeque_getsetters},
+    {Py_tp_str, ArrayDeque_str},
+    {Py_tp_repr, ArrayDeque_repr},
+    {Py_tp_richcompare, ArrayDeque_richcompare},
+    /* Sequence methods (__len__, __getitem__, __setitem__, __contains__ and
+       the arithmetic operators) */
+    {Py_sq_length, ArrayDeque_length},
+    {Py_sq_concat, ArrayDeque_concat},
+    {Py_sq_repeat, ArrayDeque_repeat},
+    {Py_sq_item, ArrayDeque_seq_getitem},
+    {Py_sq_ass_item, ArrayDeque_seq_setitem},
+    {Py_sq_contains, ArrayDeque_contains},
+    {Py_sq_inplace_concat, ArrayDeque_inplace_concat},
+    {Py_sq_inplace_repeat, ArrayDeque_inplace_repeat},
+    /* Mapping methods so that deque[index] and slices work as expected */
+    {Py_mp_length, ArrayDeque_length},
+    {Py_mp_subscript, ArrayDeque_getitem},
+    {Py_mp_ass_subscript, ArrayDeque_setitem},
+    {0, NULL}
 };
 
-/* Define mapping methods so that deque[index] works as expected. */
-static PyMappingMethods ArrayDeque_as_mapping = {
-    (lenfunc)ArrayDeque_length,       /* mp_length */
-    (binaryfunc)ArrayDeque_getitem,   /* mp_subscript */
-    (objobjargproc)ArrayDeque_setitem,/* mp_ass_subscript */
+static PyType_Spec ArrayDeque_spec = {
+    .name = "arraydeque.ArrayDeque",
+    .basicsize = sizeof(ArrayDequeObject),
+    .flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | ARRAYDEQUE_TPFLAGS_IMMUTABLE,
+    .slots = ArrayDeque_slots,
 };
 
-/* Type definition for ArrayDeque */
-static PyTypeObject ArrayDequeType = {
-    PyVarObject_HEAD_INIT(NULL, 0)
-    .tp_name = "arraydeque.ArrayDeque",
-    .tp_doc = "Array-backed deque with optional bounded length",
-    .tp_basicsize = sizeof(ArrayDequeObject),
-    .tp_itemsize = 0,
-    .tp_dealloc = (destructor)ArrayDeque_dealloc,
-    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
-    .tp_new = ArrayDeque_new,
-    .tp_init = (initproc)ArrayDeque_init,
-    .tp_iter = (getiterfunc)ArrayDeque_iter,
-    .tp_methods = ArrayDeque_methods,
-    .tp_as_sequence = &ArrayDeque_as_sequence,
-    .tp_as_mapping = &ArrayDeque_as_mapping,
-    .tp_getset = ArrayDeque_getsetters,
-    .tp_str = (reprfunc)ArrayDeque_str,
-    .tp_repr = (reprfunc)ArrayDeque_repr,
-    .tp_richcompare = ArrayDeque_richcompare,
+/* Module execution: create the types for this module object.  Each
+   interpreter that imports the module gets its own types and freelists. */
+static int
+arraydeque_exec(PyObject *module)
+{
+    ArrayDequeState *state = PyModule_GetState(module);
+
+    state->deque_type = (PyTypeObject *)PyType_FromModuleAndSpec(
+        module, &ArrayDeque_spec, NULL);
+    if (state->deque_type == NULL)
+        return -1;
+    /* There is no slot for tp_vectorcall before Python 3.14 */
+    state->deque_type->tp_vectorcall = ArrayDeque_vectorcall;
+    state->iter_type = (PyTypeObject *)PyType_FromModuleAndSpec(
+        module, &ArrayDequeIter_spec, NULL);
+    if (state->iter_type == NULL)
+        return -1;
+    state->reviter_type = (PyTypeObject *)PyType_FromModuleAndSpec(
+        module, &ArrayDequeRevIter_spec, NULL);
+    if (state->reviter_type == NULL)
+        return -1;
+#ifndef Py_TPFLAGS_DISALLOW_INSTANTIATION
+    /* Iterators are only created by __iter__ and __reversed__ */
+    state->iter_type->tp_new = NULL;
+    state->reviter_type->tp_new = NULL;
+#endif
+    if (PyModule_AddType(module, state->deque_type) < 0)
+        return -1;
+    if (PyModule_AddStringConstant(module, "__version__", ARRAYDEQUE_VERSION) < 0)
+        return -1;
+    return 0;
+}
+
+static int
+arraydeque_traverse(PyObject *module, visitproc visit, void *arg)
+{
+    ArrayDequeState *state = PyModule_GetState(module);
+    Py_VISIT(state->deque_type);
+    Py_VISIT(state->iter_type);
+    Py_VISIT(state->reviter_type);
+    return 0;
+}
+
+static int
+arraydeque_clear(PyObject *module)
+{
+    ArrayDequeState *state = PyModule_GetState(module);
+    Py_CLEAR(state->deque_type);
+    Py_CLEAR(state->iter_type);
+    Py_CLEAR(state->reviter_type);
+    return 0;
+}
+
+/* Module teardown: release the types and the freelists */
+static void
+arraydeque_free(void *module)
+{
+    arraydeque_clear((PyObject *)module);
+    arraydeque_clear_freelists(PyModule_GetState((PyObject *)module));
+}
+
+static PyModuleDef_Slot arraydeque_slots[] = {
+    {Py_mod_exec, arraydeque_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+    {0, NULL}
 };
 
 /* Module definition */
@@ -705,31 +3622,16 @@ static PyModuleDef arraydequemodule = {
     PyModuleDef_HEAD_INIT,
     .m_name = "arraydeque",
     .m_doc = "Array-based deque implementation with optional maxlen support",
-    .m_size = -1,
+    .m_size = sizeof(ArrayDequeState),
+    .m_slots = arraydeque_slots,
+    .m_traverse = arraydeque_traverse,
+    .m_clear = arraydeque_clear,
+    .m_free = arraydeque_free,
 };
 
-/* Module initialization function */
+/* Module initialization function: multi-phase, see arraydeque_exec */
 PyMODINIT_FUNC
 PyInit_arraydeque(void)
 {
-    PyObject *m;
-    if (PyType_Ready(&ArrayDequeType) < 0)
-        return NULL;
-    if (PyType_Ready(&ArrayDequeIter_Type) < 0)
-        return NULL;
-
-    m = PyModule_Create(&arraydequemodule);
-    if (m == NULL)
-        return NULL;
-    Py_INCREF(&ArrayDequeType);
-    if (PyModule_AddObject(m, "ArrayDeque", (PyObject *)&ArrayDequeType) < 0) {
-        Py_DECREF(&ArrayDequeType);
-        Py_DECREF(m);
-        return NULL;
-    }
-    if (PyModule_AddStringConstant(m, "__version__", ARRAYDEQUE_VERSION) < 0) {
-        Py_DECREF(m);
-        return NULL;
-    }
-    return m;
+    return PyModuleDef_Init(&arraydequemodule);
 }
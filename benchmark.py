@@ -9,6 +9,8 @@ on various operations:
     - pop (pop right)
     - popleft (pop left)
     - random access (read by index)
+    - fifo queue (append right, pop left at a steady size)
+    - rotate (rotations by random step counts)
     - mixed workload (a random mix of operations)
 
 Each benchmark is run 5 times and the median is taken.
@@ -37,6 +39,10 @@ POP_COUNT = 1_000_000  # number of pops (after pre-filling)
 RANDOM_ACCESS_COUNT = 100_000  # number of random accesses
 RANDOM_ACCESS_SIZE = 100_000  # size of container for random access
 MIXED_COUNT = 100_000  # iterations for mixed workload
+FIFO_COUNT = 1_000_000  # items passed through a steady-state queue
+FIFO_SIZE = 1_000  # number of items held in the queue
+ROTATE_COUNT = 1_000  # number of rotations
+ROTATE_SIZE = 100_000  # size of container for rotations
 
 
 def bench_append_right(struct, count=APPEND_COUNT):
@@ -93,6 +99,29 @@ def bench_random_access(
     return test
 
 
+def bench_fifo_queue(struct, count=FIFO_COUNT, size=FIFO_SIZE):
+    def test():
+        d = struct()
+        for i in range(size):
+            d.append(i)
+        for i in range(count):
+            d.append(i)
+            d.popleft()
+
+    return test
+
+
+def bench_rotate(struct, count=ROTATE_COUNT, size=ROTATE_SIZE):
+    steps = [random.randint(-size, size) for _ in range(count)]
+
+    def test():
+        d = struct(range(size))
+        for n in steps:
+            d.rotate(n)
+
+    return test
+
+
 def bench_mixed_workload(struct, count=MIXED_COUNT):
     ops = ('append', 'appendleft', 'pop', 'popleft', 'access')
 
@@ -138,6 +167,8 @@ def main():
         ('pop_right', bench_pop_right),
         ('pop_left', bench_pop_left),
         ('random_access', bench_random_access),
+        ('fifo_queue', bench_fifo_queue),
+        ('rotate', bench_rotate),
         ('mixed_workload', bench_mixed_workload),
     ]
 
@@ -0,0 +1,130 @@
+#!/usr/bin/env python
+"""
+benchmark_large.py
+
+Measure how arraydeque.ArrayDeque behaves when holding very large numbers
+of items:
+    - resize cost (the single append that doubles a full backing array)
+    - random access and full scans, with and without hugepages=True
+
+Large backing arrays are mapped directly from the kernel and grown with
+mremap, so the resize cost tracks page table updates rather than copying
+every pointer. For reference, each resize is compared with the time it takes
+to allocate and copy a buffer of the same size, which is what a
+copy-on-resize implementation pays.
+
+With hugepages=True the mapped arrays are aligned to 2MB and backed by
+transparent huge pages (when the kernel allows it), which reduces TLB misses
+for random indexing and scans.
+
+Each measurement is run 5 times and the median is taken. The largest size
+defaults to 2**24 items; pass an exponent to go further, e.g. 27 for about
+134 million items (which needs a few GB of memory):
+
+    python benchmark_large.py 27
+"""
+
+import itertools
+import random
+import statistics
+import struct
+import sys
+import time
+
+from collections import deque
+from arraydeque import ArrayDeque
+
+MIN_EXPONENT = 16  # smallest deque measured is 2**MIN_EXPONENT items
+MAX_EXPONENT = 24  # default largest deque measured
+REPEAT = 5  # measurements per size
+POINTER_SIZE = struct.calcsize('P')  # bytes per slot in the backing array
+RANDOM_ACCESS_SIZE = 2**24  # items in the deque for random access and scans
+RANDOM_ACCESS_COUNT = 2_000_000  # number of random accesses
+
+
+def full_deque(size, wrapped=False):
+    """
+    Return an ArrayDeque whose backing array is exactly full.
+    When wrapped is true, half of the items wrap around the end of the array.
+    """
+    d = ArrayDeque()
+    d.extend(itertools.repeat(None, size))
+    if wrapped:
+        for _ in range(size // 2):
+            d.popleft()
+        d.extend(itertools.repeat(None, size // 2))
+    assert len(d) == d.capacity == size
+    return d
+
+
+def time_resize(size, wrapped=False):
+    """Time the append that doubles a full deque of the given size."""
+    times = []
+    for _ in range(REPEAT):
+        d = full_deque(size, wrapped)
+        start = time.perf_counter()
+        d.append(None)
+        times.append(time.perf_counter() - start)
+        del d
+    return statistics.median(times)
+
+
+def time_copy(size):
+    """Time allocating and copying a pointer array of the given size."""
+    buf = bytearray(size * POINTER_SIZE)
+    times = []
+    for _ in range(REPEAT):
+        start = time.perf_counter()
+        copy = bytes(buf)
+        times.append(time.perf_counter() - start)
+        del copy
+    return statistics.median(times)
+
+
+def time_random_access(hugepages, size=RANDOM_ACCESS_SIZE):
+    """Time random indexing and a full scan of a large deque."""
+    d = ArrayDeque(hugepages=hugepages)
+    d.extend(itertools.repeat(None, size))
+    indices = [random.randrange(size) for _ in range(RANDOM_ACCESS_COUNT)]
+    marker = object()
+    access_times = []
+    scan_times = []
+    for _ in range(REPEAT):
+        start = time.perf_counter()
+        deque(map(d.__getitem__, indices), maxlen=0)
+        access_times.append(time.perf_counter() - start)
+        start = time.perf_counter()
+        d.count(marker)
+        scan_times.append(time.perf_counter() - start)
+    return statistics.median(access_times), statistics.median(scan_times)
+
+
+def main():
+    max_exponent = int(sys.argv[1]) if len(sys.argv) > 1 else MAX_EXPONENT
+
+    print(f'Resize cost (median of {REPEAT} runs, milliseconds)')
+    print(f'{"items":>12} {"resize":>10} {"wrapped":>10} {"copy":>10}')
+    for exponent in range(MIN_EXPONENT, max_exponent + 1):
+        size = 2**exponent
+        resize = time_resize(size)
+        wrapped = time_resize(size, wrapped=True)
+        copy = time_copy(size)
+        print(
+            f'{size:>12,} {resize * 1e3:>10.3f} {wrapped * 1e3:>10.3f}'
+            f' {copy * 1e3:>10.3f}'
+        )
+
+    random.seed(42)
+    print()
+    print(
+        f'Random access ({RANDOM_ACCESS_COUNT:,} reads) and scan of'
+        f' {RANDOM_ACCESS_SIZE:,} items (median of {REPEAT} runs, milliseconds)'
+    )
+    print(f'{"hugepages":>12} {"access":>10} {"scan":>10}')
+    for hugepages in (False, True):
+        access, scan = time_random_access(hugepages)
+        print(f'{str(hugepages):>12} {access * 1e3:>10.3f} {scan * 1e3:>10.3f}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+"""
+benchmark_latency.py
+
+Measure the latency distribution of individual appends to a growing
+arraydeque.ArrayDeque, with and without incremental=True.
+
+The workload is a queue that keeps growing while it is consumed (two
+appends for every popleft), so the ring buffer is wrapped whenever it has to
+grow. By default a full array is doubled at once, which moves part of the
+items in a single append; in incremental mode the old array is kept and
+items move over a few at a time on later operations, so no single append
+pays for the whole deque.
+
+Each append is timed with time.perf_counter_ns, so the numbers include the
+timer overhead. Percentiles and the maximum are reported in microseconds.
+"""
+
+import statistics
+import sys
+import time
+
+from collections import deque
+from arraydeque import ArrayDeque
+
+COUNT = 4_000_000  # appends measured per configuration
+PERCENTILES = (50, 99, 99.9, 99.99)
+
+
+def append_latencies(struct, count=COUNT):
+    d = struct()
+    latencies = [0] * count
+    clock = time.perf_counter_ns
+    for i in range(count):
+        start = clock()
+        d.append(i)
+        latencies[i] = clock() - start
+        if i % 2:
+            d.popleft()
+    return latencies
+
+
+def summarize(latencies):
+    ordered = sorted(latencies)
+    last = len(ordered) - 1
+    row = [ordered[min(last, int(len(ordered) * p / 100))] for p in PERCENTILES]
+    row.append(ordered[last])
+    row.append(statistics.mean(ordered))
+    return row
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else COUNT
+    configs = [
+        ('collections.deque', deque),
+        ('ArrayDeque', ArrayDeque),
+        ('ArrayDeque(incremental)', lambda: ArrayDeque(incremental=True)),
+    ]
+    columns = [f'p{p}' for p in PERCENTILES] + ['max', 'mean']
+
+    print(f'Append latency over {count:,} appends (microseconds)')
+    print(f'{"":>24}' + ''.join(f' {c:>10}' for c in columns))
+    for name, struct in configs:
+        row = summarize(append_latencies(struct, count))
+        print(f'{name:>24}' + ''.join(f' {ns / 1e3:>10.3f}' for ns in row))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+"""
+benchmark_small.py
+
+Compare collections.deque and arraydeque.ArrayDeque when holding only a
+handful of items (sizes 0 through 16):
+    - creation (construct from a list of n items)
+    - append/popleft (one pair on a deque holding n items)
+    - memory per instance (sys.getsizeof and tracemalloc)
+
+ArrayDeque keeps up to 8 items in slots embedded in the object, so small
+deques need a single allocation.
+
+Each timing is run 5 times and the median is taken.
+"""
+
+import statistics
+import sys
+import timeit
+import tracemalloc
+
+from collections import deque
+from arraydeque import ArrayDeque
+
+# Map names to the constructors of the two data structures.
+DATA_STRUCTS = {
+    'collections.deque': deque,
+    'arraydeque.ArrayDeque': ArrayDeque,
+}
+
+SIZES = range(17)  # number of items held by each deque
+NUMBER = 100_000  # operations per timing run
+INSTANCES = 10_000  # instances allocated to measure memory per instance
+
+
+def time_creation(struct, size):
+    items = list(range(size))
+    times = timeit.repeat(lambda: struct(items), number=NUMBER, repeat=5)
+    return statistics.median(times) / NUMBER
+
+
+def time_append_popleft(struct, size):
+    d = struct(range(size))
+
+    def test():
+        d.append(None)
+        d.popleft()
+
+    times = timeit.repeat(test, number=NUMBER, repeat=5)
+    return statistics.median(times) / NUMBER
+
+
+def traced_memory(struct, size):
+    """Return the bytes allocated per instance, as seen by tracemalloc."""
+    items = list(range(size))
+    holder = [None] * INSTANCES
+    tracemalloc.start()
+    before = tracemalloc.get_traced_memory()[0]
+    for i in range(INSTANCES):
+        holder[i] = struct(items)
+    after = tracemalloc.get_traced_memory()[0]
+    tracemalloc.stop()
+    return (after - before) / INSTANCES
+
+
+def main():
+    names = list(DATA_STRUCTS)
+    header = f'{"size":>4}' + ''.join(f' {name:>24}' for name in names)
+
+    print('Creation (nanoseconds)')
+    print(header)
+    for size in SIZES:
+        row = [time_creation(DATA_STRUCTS[name], size) for name in names]
+        print(f'{size:>4}' + ''.join(f' {t * 1e9:>24.1f}' for t in row))
+
+    print()
+    print('append + popleft (nanoseconds)')
+    print(header)
+    for size in SIZES:
+        row = [time_append_popleft(DATA_STRUCTS[name], size) for name in names]
+        print(f'{size:>4}' + ''.join(f' {t * 1e9:>24.1f}' for t in row))
+
+    print()
+    print('Memory per instance (bytes: sys.getsizeof / tracemalloc)')
+    print(header)
+    for size in SIZES:
+        cells = []
+        for name in names:
+            struct = DATA_STRUCTS[name]
+            getsizeof = sys.getsizeof(struct(range(size)))
+            traced = traced_memory(struct, size)
+            cells.append(f'{getsizeof} / {traced:.0f}')
+        print(f'{size:>4}' + ''.join(f' {cell:>24}' for cell in cells))
+
+
+if __name__ == '__main__':
+    main()
@@ -46,5 +46,5 @@ setup(
         'Programming Language :: Python :: Implementation :: CPython',
     ],
     ext_modules=[Extension('arraydeque', sources=['arraydeque.c'])],
-    python_requires='>=3.8',
+    python_requires='>=3.9',
 )
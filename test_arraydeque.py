@@ -15,6 +15,13 @@ To run the tests:
 import unittest
 import pickle
 import copy
+import gc
+import importlib.util
+import itertools
+import random
+import struct
+import sys
+import tracemalloc
 
 from arraydeque import ArrayDeque
 from collections import deque  # for reference comparisons
@@ -22,6 +29,30 @@ from collections import deque  # for reference comparisons
 # A "big" number used in some lengthy tests.
 BIG = 100000
 
+# Size of one slot of the backing array: 8 on 64-bit builds, 4 on 32-bit.
+POINTER_SIZE = struct.calcsize('P')
+
+
+# ---------------------------
+# Helpers
+# ---------------------------
+def wrapped_deque(items, offset=5):
+    """Return an ArrayDeque of items whose head has moved offset slots into
+    the ring, so that larger contents wrap around the end of the array."""
+    d = ArrayDeque([None] * offset)
+    d.extend(items)
+    for _ in range(offset):
+        d.popleft()
+    return d
+
+
+def load_module():
+    """Load a fresh, independent copy of the arraydeque module."""
+    spec = importlib.util.find_spec('arraydeque')
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
 
 # ---------------------------
 # Basic Functionality Testing
@@ -119,11 +150,12 @@ class TestArrayDequeBasic(unittest.TestCase):
         with self.assertRaises(TypeError):
             self.d['1'] = 100
 
-    def test_slice_unsuported(self):
-        # Slicing should raise a TypeError (in line with CPython's deque).
+    def test_slice(self):
+        # Slicing returns a new ArrayDeque, like slicing a list returns a list.
         self.d.extend([1, 2, 3, 4, 5])
-        with self.assertRaises(TypeError):
-            _ = self.d[1:3]
+        part = self.d[1:3]
+        self.assertIsInstance(part, ArrayDeque)
+        self.assertEqual(list(part), [2, 3])
 
     def test_contains(self):
         # Test __contains__ behavior.
@@ -139,6 +171,440 @@ class TestArrayDequeBasic(unittest.TestCase):
         d2 = ArrayDeque([])
         self.assertEqual(list(d2), [])
 
+    def test_constructor_arguments(self):
+        # Keywords and positional arguments are equivalent, for the type and
+        # for subclasses, which are built through __new__ and __init__.
+        for cls in (ArrayDeque, CustomDeque):
+            with self.subTest(cls=cls):
+                for d in (
+                    cls('abc', 2),
+                    cls('abc', maxlen=2),
+                    cls(iterable='abc', maxlen=2),
+                    cls(maxlen=2, iterable='abc', capacity=0),
+                ):
+                    self.assertIs(type(d), cls)
+                    self.assertEqual(list(d), ['b', 'c'])
+                    self.assertEqual(d.maxlen, 2)
+                d = cls(None, None, capacity=100, hugepages=1, incremental=[1])
+                self.assertEqual(d.capacity, 128)
+                self.assertTrue(d.hugepages)
+                self.assertTrue(d.incremental)
+                self.assertIsNone(cls(maxlen=None).maxlen)
+                with self.assertRaises(TypeError):
+                    cls('abc', 2, 10)
+                with self.assertRaises(TypeError):
+                    cls('abc', iterable='abc')
+                with self.assertRaises(TypeError):
+                    cls(size=2)
+                with self.assertRaises(TypeError):
+                    cls(capacity=1.5)
+                with self.assertRaises(ValueError):
+                    cls(maxlen=-1)
+                with self.assertRaises(ValueError):
+                    cls(capacity=-1)
+
+    def test_positional_methods(self):
+        d = ArrayDeque('abcb')
+        d.rotate()
+        d.rotate(-1)
+        d.insert(1, 'x')
+        self.assertEqual(list(d), list('axbcb'))
+        self.assertEqual(d.index('b', 3), 4)
+        self.assertEqual(d.rindex('b', 0, -1), 2)
+        with self.assertRaises(TypeError):
+            d.rotate(1, 2)
+        with self.assertRaises(TypeError):
+            d.rotate(1.0)
+        with self.assertRaises(TypeError):
+            d.rotate(n=1)
+        with self.assertRaises(TypeError):
+            d.insert(1)
+        with self.assertRaises(TypeError):
+            d.index()
+        with self.assertRaises(TypeError):
+            d.index('a', 0, 1, 2)
+
+
+# ---------------------------
+# Ring Buffer Wraparound Testing
+# ---------------------------
+class TestArrayDequeWraparound(unittest.TestCase):
+    def test_fifo_steady_state(self):
+        # A queue that stays small must keep working as head and tail wrap.
+        d = ArrayDeque()
+        ref = deque()
+        for i in range(1000):
+            d.append(i)
+            ref.append(i)
+            if i % 3:
+                self.assertEqual(d.popleft(), ref.popleft())
+            self.assertEqual(list(d), list(ref))
+
+    def test_reverse_fifo_steady_state(self):
+        # The mirrored queue (appendleft + pop) wraps the other way.
+        d = ArrayDeque()
+        for i in range(100):
+            d.appendleft(i)
+            d.appendleft(i)
+            self.assertEqual(d.pop(), i // 2)
+        self.assertEqual(len(d), 100)
+
+    def test_indexing_across_wrap(self):
+        # Force the live range to straddle the end of the backing array.
+        d = ArrayDeque(range(6))
+        for i in range(6, 10):
+            d.popleft()
+            d.append(i)
+        self.assertEqual(list(d), [4, 5, 6, 7, 8, 9])
+        self.assertEqual([d[i] for i in range(len(d))], [4, 5, 6, 7, 8, 9])
+        self.assertEqual(d[-1], 9)
+        d[5] = 'x'
+        self.assertEqual(d[-1], 'x')
+
+    def test_growth_while_wrapped(self):
+        d = ArrayDeque()
+        ref = deque()
+        for i in range(BIG // 10):
+            if i % 2:
+                d.appendleft(i)
+                ref.appendleft(i)
+            else:
+                d.append(i)
+                ref.append(i)
+            if i % 5 == 0:
+                self.assertEqual(d.popleft(), ref.popleft())
+        self.assertEqual(list(d), list(ref))
+        self.assertEqual(d[len(d) // 2], ref[len(ref) // 2])
+
+    def test_growth_moves_shorter_run(self):
+        # Grow a full, wrapped ring with the wrap point at every offset.
+        for shift in range(8):
+            d = ArrayDeque(range(8))
+            for i in range(shift):
+                d.append(d.popleft())
+            expected = list(d)
+            d.append('new')
+            d.appendleft('first')
+            self.assertEqual(list(d), ['first'] + expected + ['new'])
+
+    def test_remove_across_wrap(self):
+        d = ArrayDeque(range(8))
+        for i in range(8, 13):
+            d.popleft()
+            d.append(i)
+        d.remove(9)
+        self.assertEqual(list(d), [5, 6, 7, 8, 10, 11, 12])
+        self.assertEqual(d.count(12), 1)
+        self.assertIn(5, d)
+
+
+# ---------------------------
+# Capacity Management Testing
+# ---------------------------
+class TestArrayDequeCapacity(unittest.TestCase):
+    def test_default_capacity(self):
+        d = ArrayDeque()
+        self.assertEqual(d.capacity, 8)
+        with self.assertRaises(AttributeError):
+            d.capacity = 100
+
+    def test_capacity_argument(self):
+        d = ArrayDeque(capacity=1000)
+        self.assertEqual(d.capacity, 1024)
+        d.extend(range(1000))
+        self.assertEqual(d.capacity, 1024)
+        with self.assertRaises(ValueError):
+            ArrayDeque(capacity=-1)
+        with self.assertRaises(TypeError):
+            ArrayDeque([], None, 10)
+
+    def test_reserve(self):
+        d = ArrayDeque('abc')
+        d.reserve(100)
+        self.assertEqual(d.capacity, 128)
+        self.assertEqual(list(d), ['a', 'b', 'c'])
+        # Reserving less never shrinks.
+        d.reserve(10)
+        self.assertEqual(d.capacity, 128)
+        with self.assertRaises(ValueError):
+            d.reserve(-1)
+        # A bounded deque never reserves past maxlen.
+        d = ArrayDeque(maxlen=20)
+        d.reserve(1000)
+        self.assertEqual(d.capacity, 32)
+
+    def test_reserve_wrapped(self):
+        d = ArrayDeque(range(8))
+        for i in range(8, 13):
+            d.popleft()
+            d.append(i)
+        d.reserve(64)
+        self.assertEqual(list(d), list(range(5, 13)))
+
+    def test_reserved_capacity_is_kept(self):
+        d = ArrayDeque(capacity=256)
+        d.extend(range(256))
+        while d:
+            d.pop()
+        self.assertEqual(d.capacity, 256)
+        d.extend(range(10))
+        d.clear()
+        self.assertEqual(d.capacity, 256)
+
+    def test_shrink_to_fit(self):
+        d = ArrayDeque(range(1000), capacity=4096)
+        for _ in range(900):
+            d.popleft()
+        d.shrink_to_fit()
+        self.assertEqual(d.capacity, 128)
+        self.assertEqual(list(d), list(range(900, 1000)))
+        d.clear()
+        d.shrink_to_fit()
+        self.assertEqual(d.capacity, 8)
+
+    def test_automatic_shrink(self):
+        d = ArrayDeque(range(1024))
+        self.assertEqual(d.capacity, 1024)
+        while len(d) > 10:
+            d.popleft()
+        self.assertLess(d.capacity, 1024)
+        self.assertGreaterEqual(d.capacity, 16)
+        self.assertEqual(list(d), list(range(1014, 1024)))
+        d.extend(range(1000))
+        d.clear()
+        self.assertEqual(d.capacity, 8)
+
+    def test_shrink_hysteresis(self):
+        # Oscillating around a boundary must not reallocate every time.
+        d = ArrayDeque(range(64))
+        while len(d) > 15:
+            d.pop()
+        capacity = d.capacity
+        for i in range(100):
+            d.append(i)
+            d.pop()
+            d.pop()
+            d.append(i)
+            self.assertEqual(d.capacity, capacity)
+
+    def test_large_arrays(self):
+        # Large arrays switch to a different allocator; crossing the switch
+        # in both directions, with the ring wrapped, must keep every item.
+        n = 300_000
+        for hugepages in (False, True):
+            with self.subTest(hugepages=hugepages):
+                d = ArrayDeque(range(n), hugepages=hugepages)
+                for i in range(n, n + 1000):
+                    d.popleft()
+                    d.append(i)
+                d.reserve(4 * n)
+                self.assertEqual(d.capacity, 2**21)
+                self.assertEqual(d[0], 1000)
+                self.assertEqual(d[-1], n + 999)
+                d.extend(range(n))
+                self.assertEqual(len(d), 2 * n)
+                while len(d) > 10:
+                    d.pop()
+                d.shrink_to_fit()
+                self.assertEqual(d.capacity, 16)
+                self.assertEqual(list(d), list(range(1000, 1010)))
+
+    def test_hugepages_attribute(self):
+        self.assertFalse(ArrayDeque().hugepages)
+        d = ArrayDeque(hugepages=True, capacity=2**20)
+        self.assertTrue(d.hugepages)
+        with self.assertRaises(AttributeError):
+            d.hugepages = False
+
+    def test_inline_storage_round_trip(self):
+        # Small deques keep items inside the object; growing out of it and
+        # shrinking back into it, with the ring wrapped, keeps every item.
+        d = ArrayDeque(range(6))
+        for i in range(6, 9):
+            d.popleft()
+            d.append(i)
+        d.extend(range(9, 17))
+        self.assertEqual(d.capacity, 16)
+        self.assertEqual(list(d), list(range(3, 17)))
+        for _ in range(11):
+            d.popleft()
+        d.shrink_to_fit()
+        self.assertEqual(d.capacity, 8)
+        self.assertEqual(list(d), [14, 15, 16])
+        d.appendleft('a')
+        self.assertEqual(d[0], 'a')
+
+    def test_sizeof(self):
+        small = sys.getsizeof(ArrayDeque())
+        self.assertEqual(sys.getsizeof(ArrayDeque(range(8))), small)
+        d = ArrayDeque(range(100))
+        self.assertGreaterEqual(sys.getsizeof(d), small + d.capacity * POINTER_SIZE)
+
+    def test_shrink_threshold(self):
+        d = ArrayDeque()
+        self.assertEqual(d.shrink_threshold, 0.25)
+        d.shrink_threshold = 0
+        d.extend(range(1000))
+        d.clear()
+        self.assertEqual(d.capacity, 1024)
+        with self.assertRaises(ValueError):
+            d.shrink_threshold = 0.5
+        with self.assertRaises(ValueError):
+            d.shrink_threshold = -0.1
+        with self.assertRaises(TypeError):
+            del d.shrink_threshold
+        d.shrink_threshold = 0.1
+        d.append(1)
+        d.pop()
+        self.assertLess(d.capacity, 1024)
+
+
+# ---------------------------
+# Incremental Resize Testing
+# ---------------------------
+class TestArrayDequeIncremental(unittest.TestCase):
+    def check_against_deque(self, maxlen=None):
+        rng = random.Random(1234)
+        d = ArrayDeque(maxlen=maxlen, incremental=True)
+        ref = deque(maxlen=maxlen)
+        for i in range(20000):
+            op = rng.random()
+            if op < 0.35:
+                d.append(i)
+                ref.append(i)
+            elif op < 0.6:
+                d.appendleft(i)
+                ref.appendleft(i)
+            elif ref and op < 0.7:
+                self.assertEqual(d.pop(), ref.pop())
+            elif ref and op < 0.8:
+                self.assertEqual(d.popleft(), ref.popleft())
+            elif ref and op < 0.9:
+                j = rng.randrange(len(ref))
+                self.assertEqual(d[j], ref[j])
+                d[j] = ref[j] = -i
+            elif ref and op < 0.91:
+                value = ref[rng.randrange(len(ref))]
+                d.remove(value)
+                ref.remove(value)
+            elif op < 0.92:
+                self.assertEqual(list(d), list(ref))
+        self.assertEqual(list(d), list(ref))
+
+    def test_matches_deque(self):
+        self.check_against_deque()
+
+    def test_matches_deque_bounded(self):
+        self.check_against_deque(maxlen=1000)
+
+    def test_growth_is_spread_out(self):
+        d = ArrayDeque(range(1024), incremental=True)
+        self.assertTrue(d.incremental)
+        self.assertFalse(ArrayDeque().incremental)
+        size = sys.getsizeof(d)
+        d.append(1024)
+        # Both arrays are held until the migration finishes.
+        self.assertEqual(sys.getsizeof(d), size + 2048 * POINTER_SIZE)
+        self.assertEqual(d[0], 0)
+        self.assertEqual(d[1024], 1024)
+        for i in range(1025, 1400):
+            d.append(i)
+        self.assertEqual(sys.getsizeof(d), size + 1024 * POINTER_SIZE)
+        self.assertEqual(list(d), list(range(1400)))
+
+    def test_extend_growth_is_spread_out(self):
+        # extend(), extendleft() and += add items one at a time, so a small
+        # batch neither finishes a pending migration nor grows in one step.
+        for extend in (
+            ArrayDeque.extend,
+            ArrayDeque.extendleft,
+            ArrayDeque.__iadd__,
+        ):
+            with self.subTest(extend=extend.__name__):
+                d = ArrayDeque(range(1024), incremental=True)
+                for _ in range(300):
+                    d.append(d.popleft())  # still full, now wrapped
+                size = sys.getsizeof(d)
+                extend(d, [1024])
+                self.assertEqual(sys.getsizeof(d), size + 2048 * POINTER_SIZE)
+                extend(d, (1025, 1026))
+                extend(d, ArrayDeque([1027]))
+                extend(d, iter([1028]))
+                self.assertEqual(sys.getsizeof(d), size + 2048 * POINTER_SIZE)
+                items = list(range(300, 1024)) + list(range(300))
+                added = list(range(1024, 1029))
+                if extend is ArrayDeque.extendleft:
+                    self.assertEqual(list(d), added[::-1] + items)
+                else:
+                    self.assertEqual(list(d), items + added)
+
+    def test_pops_do_not_shrink(self):
+        # A shrink copies every item at once, so incremental deques keep
+        # their array until shrink_to_fit() is called.
+        d = ArrayDeque(range(4096), incremental=True)
+        d.append(4096)
+        capacity = d.capacity
+        while len(d) > 1:
+            d.popleft()
+            self.assertEqual(d.capacity, capacity)
+        d.pop()
+        self.assertEqual(d.capacity, capacity)
+        d.extend(range(10))
+        d.shrink_to_fit()
+        self.assertEqual(d.capacity, 16)
+        self.assertEqual(list(d), list(range(10)))
+        # Re-initializing without incremental restores automatic shrinking.
+        d.__init__(range(1000))
+        for _ in range(900):
+            d.pop()
+        self.assertLess(d.capacity, 1024)
+
+    def test_bulk_operations_during_migration(self):
+        d = ArrayDeque(range(64), incremental=True)
+        d.append(64)
+        d.appendleft(-1)
+        self.assertEqual(d.count(10), 1)
+        self.assertIn(63, d)
+        d.remove(30)
+        self.assertEqual(list(d), [x for x in range(-1, 65) if x != 30])
+        d.reserve(1000)
+        self.assertEqual(d.capacity, 1024)
+        self.assertEqual(pickle.loads(pickle.dumps(d)), d)
+        d.clear()
+        self.assertEqual(list(d), [])
+
+
+# ---------------------------
+# Instance Reuse Testing
+# ---------------------------
+class TestArrayDequeReuse(unittest.TestCase):
+    def test_recycled_instances_start_fresh(self):
+        # Dead deques and iterators are recycled; none of their state may
+        # leak into the next instance.
+        for i in range(200):
+            d = ArrayDeque(range(i % 20), maxlen=50, capacity=i)
+            d.shrink_threshold = 0.1
+            it = iter(d)
+            next(it, None)
+            del d, it
+            d = ArrayDeque()
+            self.assertEqual(len(d), 0)
+            self.assertIsNone(d.maxlen)
+            self.assertEqual(d.capacity, 8)
+            self.assertEqual(d.shrink_threshold, 0.25)
+            self.assertFalse(d.hugepages)
+            self.assertEqual(list(iter(d)), [])
+
+    def test_many_short_lived(self):
+        deques = [ArrayDeque([i, i + 1]) for i in range(500)]
+        iterators = [iter(d) for d in deques]
+        del deques
+        self.assertEqual([next(it) for it in iterators], list(range(500)))
+        del iterators
+        d = CustomDeque('ab')
+        self.assertIsInstance(d, CustomDeque)
+        self.assertEqual(list(d), ['a', 'b'])
+
 
 # ---------------------------
 # Rotation Testing
@@ -172,6 +638,730 @@ class TestArrayDequeRotation(unittest.TestCase):
         d_empty.rotate(5)
         self.assertEqual(list(d_empty), [])
 
+    def test_rotate_matches_deque(self):
+        # Cover wrapped layouts, full arrays and both directions.
+        for size in (1, 2, 3, 7, 8, 9, 16, 31, 33, 100):
+            for offset in (0, 3, size // 2):
+                d = ArrayDeque(range(size))
+                ref = deque(range(size))
+                for _ in range(offset):
+                    d.append(d.popleft())
+                    ref.append(ref.popleft())
+                for n in (1, -1, 2, -3, size // 2, -(size // 2), size - 1,
+                          size + 1, -size - 2, 10 * size + 3):
+                    with self.subTest(size=size, offset=offset, n=n):
+                        d.rotate(n)
+                        ref.rotate(n)
+                        self.assertEqual(list(d), list(ref))
+
+    def test_rotate_keeps_capacity(self):
+        d = ArrayDeque(range(1000))
+        capacity = d.capacity
+        for n in (1, 499, 500, 501, -250, 999):
+            d.rotate(n)
+            self.assertEqual(d.capacity, capacity)
+        self.assertEqual(sorted(d), list(range(1000)))
+
+    def test_rotate_large(self):
+        d = ArrayDeque(range(BIG))
+        ref = deque(range(BIG))
+        for n in (BIG // 3, -BIG // 7, BIG // 2, 12345):
+            d.rotate(n)
+            ref.rotate(n)
+        self.assertEqual(list(d), list(ref))
+
+    def test_rotate_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        d.rotate(3)
+        self.assertEqual(list(d), [6, 7, 8, 0, 1, 2, 3, 4, 5])
+
+
+# ---------------------------
+# Bulk Extend Testing
+# ---------------------------
+class TestArrayDequeExtend(unittest.TestCase):
+    def sources(self, items):
+        # The same items as each kind of input extend() handles.
+        return [
+            list(items),
+            tuple(items),
+            ArrayDeque(items),
+            wrapped_deque(items),
+            deque(items),
+            iter(items),
+            (item for item in items),
+        ]
+
+    def test_extend_sources(self):
+        for size in (0, 1, 7, 8, 9, 100):
+            items = list(range(size))
+            for maxlen in (None, 0, 1, 5, 50, 1000):
+                for source in self.sources(items):
+                    with self.subTest(size=size, maxlen=maxlen, source=type(source)):
+                        # Start from a deque whose head has moved.
+                        d = ArrayDeque('abc', maxlen=maxlen)
+                        ref = deque('abc', maxlen=maxlen)
+                        if ref:
+                            d.popleft()
+                            ref.popleft()
+                        d.extend(source)
+                        ref.extend(items)
+                        self.assertEqual(list(d), list(ref))
+
+    def test_extend_subclass_iter(self):
+        # Subclasses that override __iter__ are iterated, not copied in bulk.
+        class L(list):
+            def __iter__(self):
+                return iter(['x'])
+
+        class T(tuple):
+            def __iter__(self):
+                return iter(['x'])
+
+        class D(ArrayDeque):
+            def __iter__(self):
+                return iter(['x'])
+
+        for source in (L([1, 2]), T([1, 2]), D([1, 2])):
+            with self.subTest(source=type(source)):
+                self.assertEqual(list(ArrayDeque(source)), ['x'])
+                d = ArrayDeque()
+                d.extend(source)
+                self.assertEqual(list(d), ['x'])
+                d += source
+                self.assertEqual(list(d), ['x', 'x'])
+        self.assertEqual(list(ArrayDeque(CustomDeque([1, 2]))), [1, 2])
+
+    def test_extend_wrapped_destination(self):
+        d = ArrayDeque(range(12))
+        for _ in range(10):
+            d.append(d.popleft())
+        d.extend(range(100, 104))
+        self.assertEqual(list(d), list(range(10, 12)) + list(range(10)) + list(range(100, 104)))
+
+    def test_extend_self(self):
+        d = ArrayDeque('abc')
+        d.extend(d)
+        self.assertEqual(list(d), list('abcabc'))
+        d = ArrayDeque('abcd', maxlen=6)
+        d.extend(d)
+        self.assertEqual(list(d), list('cdabcd'))
+
+    def test_extend_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque(maxlen=3)
+        d.extend([item] * 10)
+        d.extend((item,) * 2)
+        d.extend(ArrayDeque([item] * 5))
+        self.assertEqual(sys.getrefcount(item), before + 3)
+        d.clear()
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_extend_evicts_after_storing(self):
+        # Evicted items are released once the deque is consistent again.
+        seen = []
+
+        class Witness:
+            def __del__(self):
+                seen.append(list(d))
+
+        d = ArrayDeque([Witness(), 1], maxlen=2)
+        d.extend([2, 3])
+        self.assertEqual(seen, [[2, 3]])
+
+    def test_extend_presizes_from_length_hint(self):
+        d = ArrayDeque()
+        d.extend(iter(range(1000)))
+        self.assertEqual(d.capacity, 1024)
+        d = ArrayDeque(maxlen=10)
+        d.extend(iter(range(1000)))
+        self.assertEqual(list(d), list(range(990, 1000)))
+        self.assertEqual(d.capacity, 16)
+
+    def test_extend_trims_overestimated_length_hint(self):
+        class Liar:
+            def __init__(self, items):
+                self.items = iter(items)
+
+            def __iter__(self):
+                return self
+
+            def __next__(self):
+                return next(self.items)
+
+            def __length_hint__(self):
+                return 2**20
+
+        d = ArrayDeque()
+        d.extend(Liar('abc'))
+        self.assertEqual(list(d), list('abc'))
+        self.assertEqual(d.capacity, 8)
+        d = ArrayDeque(capacity=64)
+        d.extendleft(Liar(range(40)))
+        self.assertEqual(len(d), 40)
+        self.assertEqual(d.capacity, 64)
+
+    def test_extend_iterator_error(self):
+        def gen():
+            yield 1
+            yield 2
+            raise ZeroDivisionError
+
+        d = ArrayDeque()
+        with self.assertRaises(ZeroDivisionError):
+            d.extend(gen())
+        self.assertEqual(list(d), [1, 2])
+        with self.assertRaises(TypeError):
+            d.extend(1)
+
+    def test_extend_maxlen_zero_consumes(self):
+        it = iter(range(10))
+        d = ArrayDeque(maxlen=0)
+        d.extend(it)
+        self.assertEqual(list(it), [])
+        self.assertEqual(list(d), [])
+
+    def test_extend_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        d.extend(range(9, 20))
+        self.assertEqual(list(d), list(range(20)))
+        other = ArrayDeque(range(8), incremental=True)
+        other.append(8)
+        d.extend(other)
+        self.assertEqual(list(d), list(range(20)) + list(range(9)))
+
+
+    def test_extendleft_sources(self):
+        for size in (0, 1, 7, 8, 9, 100):
+            items = list(range(size))
+            for maxlen in (None, 0, 1, 5, 50, 1000):
+                for source in self.sources(items):
+                    with self.subTest(size=size, maxlen=maxlen, source=type(source)):
+                        d = ArrayDeque('abc', maxlen=maxlen)
+                        ref = deque('abc', maxlen=maxlen)
+                        d.extendleft(source)
+                        ref.extendleft(items)
+                        self.assertEqual(list(d), list(ref))
+
+    def test_extendleft_subclass_iter(self):
+        # Subclasses that override __iter__ are iterated, not copied in bulk.
+        class L(list):
+            def __iter__(self):
+                return iter(['x', 'y'])
+
+        class T(tuple):
+            def __iter__(self):
+                return iter(['x', 'y'])
+
+        class D(ArrayDeque):
+            def __iter__(self):
+                return iter(['x', 'y'])
+
+        for source in (L([1, 2]), T([1, 2]), D([1, 2])):
+            with self.subTest(source=type(source)):
+                d = ArrayDeque()
+                d.extendleft(source)
+                self.assertEqual(list(d), ['y', 'x'])
+        d = ArrayDeque()
+        d.extendleft(CustomDeque([1, 2]))
+        self.assertEqual(list(d), [2, 1])
+
+    def test_extendleft_self(self):
+        d = ArrayDeque('abc')
+        d.extendleft(d)
+        self.assertEqual(list(d), list('cbaabc'))
+        d = ArrayDeque('abcd', maxlen=6)
+        d.extendleft(d)
+        self.assertEqual(list(d), list('dcbaab'))
+
+    def test_extendleft_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque(maxlen=3)
+        d.extendleft([item] * 10)
+        d.extendleft(ArrayDeque([item] * 5))
+        d.extendleft(iter([item] * 2))
+        self.assertEqual(sys.getrefcount(item), before + 3)
+        d.clear()
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_extendleft_no_temporary_list(self):
+        items = [None] * BIG
+        for source in (items, itertools.repeat(None, BIG)):
+            d = ArrayDeque(capacity=BIG)
+            tracemalloc.start()
+            d.extendleft(source)
+            peak = tracemalloc.get_traced_memory()[1]
+            tracemalloc.stop()
+            self.assertEqual(len(d), BIG)
+            self.assertLess(peak, BIG)
+
+    def test_extendleft_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        d.extendleft([-1, -2])
+        self.assertEqual(list(d), list(range(-2, 9)))
+
+
+# ---------------------------
+# Bulk Pop Testing
+# ---------------------------
+class TestArrayDequeBulkPop(unittest.TestCase):
+    def test_popleftn(self):
+        for size in (0, 1, 8, 9, 100):
+            for k in (0, 1, 3, size, size + 1):
+                with self.subTest(size=size, k=k):
+                    d = wrapped_deque(range(size))
+                    ref = deque(range(size))
+                    expected = [ref.popleft() for _ in range(min(k, size))]
+                    self.assertEqual(d.popleftn(k), expected)
+                    self.assertEqual(list(d), list(ref))
+
+    def test_popn(self):
+        for size in (0, 1, 8, 9, 100):
+            for k in (0, 1, 3, size, size + 1):
+                with self.subTest(size=size, k=k):
+                    d = wrapped_deque(range(size))
+                    ref = deque(range(size))
+                    expected = [ref.pop() for _ in range(min(k, size))]
+                    self.assertEqual(d.popn(k), expected)
+                    self.assertEqual(list(d), list(ref))
+
+    def test_drain(self):
+        d = wrapped_deque(range(100))
+        self.assertEqual(d.drain(), list(range(100)))
+        self.assertEqual(len(d), 0)
+        self.assertEqual(d.capacity, 8)
+        self.assertEqual(d.drain(), [])
+        d.extend('abc')
+        self.assertEqual(list(d), ['a', 'b', 'c'])
+
+    def test_pop_nothing_keeps_iterators(self):
+        d = ArrayDeque('abc')
+        it = iter(d)
+        self.assertEqual(next(it), 'a')
+        self.assertEqual(d.popleftn(0), [])
+        self.assertEqual(d.popn(0), [])
+        self.assertEqual(next(it), 'b')
+        empty = ArrayDeque()
+        it = iter(empty)
+        self.assertEqual(empty.drain(), [])
+        self.assertEqual(list(it), [])
+        # Popping at least one item still invalidates them.
+        it = iter(d)
+        d.popn(1)
+        with self.assertRaises(RuntimeError):
+            next(it)
+
+    def test_bulk_pop_errors(self):
+        d = ArrayDeque('abc')
+        with self.assertRaises(ValueError):
+            d.popleftn(-1)
+        with self.assertRaises(ValueError):
+            d.popn(-1)
+        with self.assertRaises(TypeError):
+            d.popn(1.5)
+        self.assertEqual(d.popleftn(2**100), ['a', 'b', 'c'])
+
+    def test_bulk_pop_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item] * 10)
+        batch = d.popleftn(4) + d.popn(4) + d.drain()
+        self.assertEqual(len(batch), 10)
+        del d
+        self.assertEqual(sys.getrefcount(item), before + 10)
+        del batch
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_bulk_pop_shrinks(self):
+        d = ArrayDeque(range(1000))
+        d.popleftn(990)
+        self.assertLess(d.capacity, 64)
+        self.assertEqual(list(d), list(range(990, 1000)))
+        d = ArrayDeque(range(1000), capacity=1000)
+        d.drain()
+        self.assertEqual(d.capacity, 1024)
+
+    def test_bulk_pop_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        self.assertEqual(d.popn(2), [8, 7])
+        self.assertEqual(d.popleftn(2), [0, 1])
+        self.assertEqual(d.drain(), [2, 3, 4, 5, 6])
+
+
+# ---------------------------
+# Slicing Testing
+# ---------------------------
+class TestArrayDequeSlicing(unittest.TestCase):
+    # Slices are checked against the same operation on a list.
+    SLICES = [
+        slice(None),
+        slice(2, 7),
+        slice(-3, None),
+        slice(None, -2),
+        slice(5, 2),
+        slice(None, None, 2),
+        slice(1, None, 3),
+        slice(None, None, -1),
+        slice(8, 1, -2),
+        slice(-100, 100),
+        slice(100, None),
+    ]
+
+    def layouts(self, size):
+        # Deques of size items in different positions around the ring.
+        for offset in (0, 3, 6):
+            d = wrapped_deque(range(size), offset)
+            d.append(None)
+            d.pop()
+            yield d
+
+    def test_getitem_slice(self):
+        for size in (0, 1, 8, 10, 13):
+            for d in self.layouts(size):
+                for key in self.SLICES:
+                    with self.subTest(size=size, key=key):
+                        part = d[key]
+                        self.assertIs(type(part), ArrayDeque)
+                        self.assertEqual(list(part), list(range(size))[key])
+                        self.assertEqual(len(d), size)
+
+    def test_getitem_slice_is_a_copy(self):
+        d = ArrayDeque(range(10), maxlen=10)
+        part = d[:]
+        self.assertIsNone(part.maxlen)
+        part.append(10)
+        self.assertEqual(list(d), list(range(10)))
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item] * 20)
+        parts = [d[2:10], d[::3]]
+        self.assertEqual(sys.getrefcount(item), before + 35)
+        del d, parts
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_setitem_slice(self):
+        values = ([], ['a'], ['a', 'b', 'c'], list('abcdefghijklmnopqrst'))
+        for size in (0, 1, 8, 10, 13):
+            for key in self.SLICES:
+                for value in values:
+                    for d in self.layouts(size):
+                        ref = list(range(size))
+                        try:
+                            ref[key] = value
+                        except ValueError:
+                            with self.assertRaises(ValueError):
+                                d[key] = value
+                            continue
+                        with self.subTest(size=size, key=key, value=value):
+                            d[key] = iter(value) if key.step is None else value
+                            self.assertEqual(list(d), ref)
+
+    def test_delitem_slice(self):
+        for size in (0, 1, 8, 10, 13, 40):
+            for key in self.SLICES:
+                for d in self.layouts(size):
+                    with self.subTest(size=size, key=key):
+                        ref = list(range(size))
+                        del ref[key]
+                        del d[key]
+                        self.assertEqual(list(d), ref)
+
+    def test_setitem_slice_self(self):
+        d = ArrayDeque('abc')
+        d[1:2] = d
+        self.assertEqual(list(d), list('aabcc'))
+        d[::-1] = d
+        self.assertEqual(list(d), list('ccbaa'))
+
+    def test_setitem_slice_maxlen(self):
+        d = ArrayDeque('abcd', maxlen=5)
+        d[1:2] = 'xy'
+        self.assertEqual(list(d), list('axycd'))
+        with self.assertRaises(ValueError):
+            d[:0] = 'z'
+        self.assertEqual(list(d), list('axycd'))
+        d[:2] = 'z'
+        self.assertEqual(list(d), list('zycd'))
+
+    def test_delitem_slice_over_maxlen(self):
+        # Re-initializing with a smaller maxlen keeps the items, so the deque
+        # is over its bound; deleting slices must still work.
+        d = ArrayDeque(range(10))
+        d.__init__(maxlen=3)
+        del d[0:1]
+        self.assertEqual(list(d), list(range(1, 10)))
+        del d[::2]
+        self.assertEqual(list(d), [2, 4, 6, 8])
+
+    def test_setitem_slice_errors(self):
+        d = ArrayDeque('abc')
+        with self.assertRaises(TypeError):
+            d[:] = 5
+        with self.assertRaises(ValueError):
+            d[::2] = 'xyz'
+        self.assertEqual(list(d), list('abc'))
+
+    def test_slice_references(self):
+        item, other = object(), object()
+        before = sys.getrefcount(item), sys.getrefcount(other)
+        d = ArrayDeque([item] * 20)
+        d[3:10] = [other] * 4
+        d[::2] = [other] * len(d[::2])
+        del d[1:5]
+        del d[::3]
+        d.clear()
+        self.assertEqual((sys.getrefcount(item), sys.getrefcount(other)), before)
+
+    def test_slice_shrinks(self):
+        d = ArrayDeque(range(1000))
+        del d[10:]
+        self.assertEqual(list(d), list(range(10)))
+        self.assertLess(d.capacity, 64)
+
+    def test_slice_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        self.assertEqual(list(d[2:5]), [2, 3, 4])
+        d[1:3] = 'ab'
+        del d[::4]
+        self.assertEqual(list(d), ['a', 'b', 3, 5, 6, 7])
+
+
+# ---------------------------
+# Sorting Testing
+# ---------------------------
+class Counted:
+    comparisons = 0
+
+    def __init__(self, value):
+        self.value = value
+
+    def __lt__(self, other):
+        Counted.comparisons += 1
+        return self.value < other.value
+
+
+class TestArrayDequeSort(unittest.TestCase):
+    def test_sort_matches_list(self):
+        rng = random.Random(19)
+        for n in (0, 1, 2, 7, 8, 9, 100, 1000):
+            for values in (
+                [rng.randrange(50) for _ in range(n)],
+                [rng.random() for _ in range(n)],
+                [str(rng.randrange(1000)) for _ in range(n)],
+                [rng.randrange(-(2**70), 2**70) for _ in range(n)],
+            ):
+                for reverse in (False, True):
+                    d = ArrayDeque(values)
+                    d.sort(reverse=reverse)
+                    self.assertEqual(list(d), sorted(values, reverse=reverse))
+
+    def test_sort_wrapped(self):
+        d = ArrayDeque(range(100), incremental=True)
+        d.rotate(37)
+        d.extend(range(100, 200))
+        d.sort(reverse=True)
+        self.assertEqual(list(d), list(range(199, -1, -1)))
+        d.append(-1)
+        d.appendleft(200)
+        self.assertEqual(d[0], 200)
+        self.assertEqual(d[-1], -1)
+
+    def test_sort_key_is_stable(self):
+        words = ['bb', 'a', 'ccc', 'dd', 'e', 'fff', 'gg']
+        for reverse in (False, True):
+            d = ArrayDeque(words)
+            d.sort(key=len, reverse=reverse)
+            self.assertEqual(list(d), sorted(words, key=len, reverse=reverse))
+
+    def test_sort_already_sorted(self):
+        values = [Counted(i // 2) for i in range(100)]
+        d = ArrayDeque(values)
+        Counted.comparisons = 0
+        d.sort()
+        self.assertEqual(Counted.comparisons, 99)
+        self.assertEqual(list(d), values)
+        d = ArrayDeque(reversed(values))
+        d.sort(reverse=True)
+        self.assertEqual(list(d), list(reversed(values)))
+
+    def test_sort_arguments(self):
+        d = ArrayDeque([3, 1, 2])
+        with self.assertRaises(TypeError):
+            d.sort(len)
+        with self.assertRaises(TypeError):
+            d.sort(cmp=len)
+        self.assertEqual(list(d), [3, 1, 2])
+
+    def test_sort_failure_keeps_items(self):
+        d = ArrayDeque([3, 'a', 1, None, 2])
+        with self.assertRaises(TypeError):
+            d.sort()
+        self.assertEqual(sorted(d, key=repr), sorted([3, 'a', 1, None, 2], key=repr))
+
+    def test_sort_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item] * 10)
+        d.sort(key=id)
+        self.assertEqual(sys.getrefcount(item), before + 10)
+        del d
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_sort_mutation(self):
+        d = ArrayDeque([3, 1, 2])
+        seen = []
+
+        def key(x):
+            seen.append(len(d))
+            d.append(x)
+            return x
+
+        with self.assertRaises(ValueError):
+            d.sort(key=key)
+        self.assertEqual(seen, [0, 1, 2])
+        self.assertEqual(list(d), [1, 2, 3])
+
+        class Mutating:
+            def __lt__(self, other):
+                d.clear()
+                return False
+
+        d = ArrayDeque([1, Mutating(), Mutating()])
+        with self.assertRaises(ValueError):
+            d.sort()
+
+
+# ---------------------------
+# Sequence Arithmetic Testing
+# ---------------------------
+class TestArrayDequeArithmetic(unittest.TestCase):
+    def test_add(self):
+        a = ArrayDeque('abc')
+        b = ArrayDeque('de')
+        c = a + b
+        self.assertIs(type(c), ArrayDeque)
+        self.assertEqual(list(c), list('abcde'))
+        self.assertEqual(list(a), list('abc'))
+        self.assertEqual(list(a + a), list('abcabc'))
+        self.assertEqual(list(ArrayDeque() + ArrayDeque()), [])
+        with self.assertRaises(TypeError):
+            _ = a + ['d']
+        with self.assertRaises(TypeError):
+            _ = ['d'] + a
+
+    def test_add_maxlen(self):
+        for n in range(8):
+            a = ArrayDeque(range(5), maxlen=5)
+            b = ArrayDeque(range(10, 10 + n))
+            c = a + b
+            self.assertEqual(c.maxlen, 5)
+            self.assertEqual(list(c), (list(range(5)) + list(b))[-5:])
+        self.assertEqual(list(ArrayDeque([1], maxlen=0) + ArrayDeque([2])), [])
+
+    def test_iadd(self):
+        d = ArrayDeque('ab')
+        alias = d
+        d += 'cd'
+        d += ['e']
+        d += d
+        self.assertIs(d, alias)
+        self.assertEqual(list(d), list('abcdeabcde'))
+        d = ArrayDeque('ab', maxlen=3)
+        d += range(5)
+        self.assertEqual(list(d), [2, 3, 4])
+
+    def test_mul(self):
+        for size in (0, 1, 3, 8, 9):
+            values = list(range(size))
+            d = ArrayDeque(values)
+            for n in (-1, 0, 1, 2, 3, 7):
+                self.assertEqual(list(d * n), values * n)
+                self.assertEqual(list(n * d), values * n)
+            self.assertEqual(list(d), values)
+
+    def test_mul_maxlen(self):
+        values = list('abc')
+        for maxlen in range(3, 12):
+            for n in range(5):
+                d = ArrayDeque(values, maxlen=maxlen)
+                self.assertEqual(list(d * n), (values * n)[-maxlen:] if n else [])
+                d *= n
+                self.assertEqual(list(d), (values * n)[-maxlen:] if n else [])
+        d = ArrayDeque(range(3), maxlen=5)
+        self.assertEqual(list(d * sys.maxsize), [1, 2, 0, 1, 2])
+        d *= sys.maxsize
+        self.assertEqual(list(d), [1, 2, 0, 1, 2])
+
+    def test_mul_over_maxlen(self):
+        # Re-initializing with a smaller maxlen keeps the items, so the deque
+        # is over its bound; repeating it keeps only the last maxlen items.
+        d = ArrayDeque(range(100000))
+        d.__init__(maxlen=5)
+        for n in (1, 2, 3):
+            result = d * n
+            self.assertEqual(list(result), list(range(99995, 100000)))
+            self.assertEqual(result.maxlen, 5)
+        self.assertEqual(len(d), 100000)
+        # d *= n agrees with d * n, including for n == 1
+        for n in (1, 2):
+            d = ArrayDeque(range(20))
+            d.__init__(maxlen=5)
+            d *= n
+            self.assertEqual(list(d), list(range(15, 20)))
+
+    def test_imul(self):
+        for size in (0, 1, 3, 8, 9):
+            values = list(range(size))
+            for n in (-1, 0, 1, 2, 3, 100):
+                d = ArrayDeque(values, incremental=True)
+                d.rotate(2)
+                alias = d
+                d *= n
+                self.assertIs(d, alias)
+                rotated = values[-2:] + values[:-2] if size > 2 else values
+                self.assertEqual(list(d), rotated * n)
+
+    def test_mul_overflow(self):
+        with self.assertRaises(MemoryError):
+            _ = ArrayDeque('ab') * sys.maxsize
+        d = ArrayDeque('ab')
+        with self.assertRaises(MemoryError):
+            d *= sys.maxsize
+        self.assertEqual(list(d), ['a', 'b'])
+
+    def test_mul_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item, None])
+        d2 = d * 50
+        d *= 20
+        self.assertEqual(sys.getrefcount(item), before + 70)
+        del d, d2
+        self.assertEqual(sys.getrefcount(item), before)
+        # A deque over its maxlen drops the extra items from the left
+        d = ArrayDeque([item] * 20)
+        d.__init__(maxlen=5)
+        d *= 2
+        self.assertEqual(len(d), 5)
+        self.assertEqual(sys.getrefcount(item), before + 5)
+        del d
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_arithmetic_subclass(self):
+        d = CustomDeque('ab', maxlen=3)
+        for result in (d + ArrayDeque('c'), d * 2):
+            self.assertIs(type(result), CustomDeque)
+            self.assertEqual(result.maxlen, 3)
+        self.assertEqual(list(d + ArrayDeque('cd')), list('bcd'))
+        self.assertEqual(list(d * 2), list('bab'))
+
 
 # ---------------------------
 # Maxlen (Bounded) Behavior Testing
@@ -245,25 +1435,267 @@ class TestArrayDequeComparisons(unittest.TestCase):
         d3 = ArrayDeque('abcd')
         self.assertNotEqual(self.ad, d3)
 
+    def test_equality_other_types(self):
+        self.assertEqual(self.ad, ['a', 'b', 'c'])
+        self.assertEqual(self.ad, ('a', 'b', 'c'))
+        self.assertEqual(self.ad, self.cd)
+        self.assertNotEqual(self.ad, ['a', 'b'])
+        self.assertNotEqual(self.ad, ('a', 'b', 'd'))
+        self.assertFalse(self.ad == 5)
+        self.assertTrue(self.ad != None)  # noqa: E711
+        self.assertEqual(ArrayDeque(), [])
+
+    def test_ordering(self):
+        values = [[], [0], [1], [0, 0], [0, 1], [1, 0], [0, 0, 0], [2]]
+        for x in values:
+            for y in values:
+                a, b = ArrayDeque(x), ArrayDeque(y)
+                cx, cy = deque(x), deque(y)
+                with self.subTest(x=x, y=y):
+                    self.assertEqual(a == b, cx == cy)
+                    self.assertEqual(a != b, cx != cy)
+                    self.assertEqual(a < b, cx < cy)
+                    self.assertEqual(a <= b, cx <= cy)
+                    self.assertEqual(a > b, cx > cy)
+                    self.assertEqual(a >= b, cx >= cy)
+                    self.assertEqual(a < list(y), cx < cy)
+                    self.assertEqual(tuple(x) < b, cx < cy)
+        with self.assertRaises(TypeError):
+            _ = self.ad < 5
+        with self.assertRaises(TypeError):
+            _ = ArrayDeque([1]) < ArrayDeque(['a'])
+
+    def test_equality_wrapped(self):
+        d = ArrayDeque(range(8))
+        d.rotate(3)
+        e = ArrayDeque(range(20), incremental=True)
+        for _ in range(12):
+            e.popleft()
+        d2 = ArrayDeque([5, 6, 7, 0, 1, 2, 3, 4])
+        self.assertEqual(d, d2)
+        self.assertNotEqual(d, e)
+        e.rotate(3)
+        self.assertEqual(list(e), [17, 18, 19, 12, 13, 14, 15, 16])
+        self.assertEqual(ArrayDeque(x - 12 for x in e), d)
+
+    def test_equality_identity_and_nan(self):
+        nan = float('nan')
+        self.assertEqual(ArrayDeque([nan]), [nan])
+        self.assertNotEqual(ArrayDeque([nan]), [float('nan')])
+        self.assertEqual(ArrayDeque([1, 2.0, 'x', b'y']), [1.0, 2, 'x', b'y'])
+        self.assertNotEqual(ArrayDeque([2**70]), [2**70 + 1])
+
+    def test_comparison_mutation(self):
+        d = ArrayDeque()
+
+        class Mutating:
+            def __eq__(self, other):
+                d.append(None)
+                return True
+
+        d.extend([Mutating(), 1])
+        with self.assertRaises(RuntimeError):
+            _ = d == [object(), 1]
+
+        class Shrinking:
+            def __eq__(self, other):
+                other_list.clear()
+                return True
+
+        other_list = [1, 2, 3]
+        self.assertFalse(ArrayDeque([Shrinking(), 2, 3]) <= other_list)
+
+    def test_ordering_after_item_replaced(self):
+        # __eq__ drops the last reference to the items being compared; the
+        # ordering comparison must use the items now in their place.
+        class Replacing:
+            def __eq__(self, other):
+                d[0] = 0
+                return False
+
+        d = ArrayDeque([Replacing()])
+        self.assertTrue(d < [1])
+
+        class Clearing:
+            def __eq__(self, other):
+                other_list.clear()
+                return False
+
+        other_list = [Clearing()]
+        self.assertFalse(ArrayDeque([1]) < other_list)
+        self.assertTrue(ArrayDeque([1]) > other_list)
+
+    def test_iterator_length_hint(self):
+        d = ArrayDeque(range(20))
+        it = iter(d)
+        self.assertEqual(it.__length_hint__(), 20)
+        next(it)
+        next(it)
+        self.assertEqual(it.__length_hint__(), 18)
+        list(it)
+        self.assertEqual(it.__length_hint__(), 0)
+
+    def test_iterator_mutation(self):
+        mutations = [
+            lambda d: d.append(0),
+            lambda d: d.appendleft(0),
+            lambda d: d.pop(),
+            lambda d: d.popleft(),
+            lambda d: d.extend([0, 0]),
+            lambda d: d.extendleft([0]),
+            lambda d: d.rotate(1),
+            lambda d: d.reverse(),
+            lambda d: d.insert(2, 0),
+            lambda d: d.remove(3),
+            lambda d: d.clear(),
+            lambda d: d.sort(reverse=True),
+            lambda d: d.popleftn(2),
+            lambda d: d.__delitem__(slice(1, 3)),
+            lambda d: d.__imul__(2),
+        ]
+        for mutate in mutations:
+            for make_iter in (iter, reversed):
+                d = ArrayDeque(range(8))
+                it = make_iter(d)
+                next(it)
+                mutate(d)
+                with self.assertRaises(RuntimeError):
+                    next(it)
+                self.assertEqual(list(it), [])
+        # Assigning items does not move any, so iteration carries on.
+        d = ArrayDeque(range(4))
+        it = iter(d)
+        next(it)
+        d[1] = 'x'
+        d[2:4] = 'yz'
+        self.assertEqual(list(it), ['x', 'y', 'z'])
+
+    def test_iterator_pickle(self):
+        d = ArrayDeque('abcdef')
+        for proto in range(pickle.HIGHEST_PROTOCOL + 1):
+            for make_iter, expected in ((iter, 'abcdef'), (reversed, 'fedcba')):
+                it = make_iter(d)
+                self.assertEqual(list(pickle.loads(pickle.dumps(it, proto))),
+                                 list(expected))
+                next(it)
+                next(it)
+                it2 = pickle.loads(pickle.dumps(it, proto))
+                self.assertIs(type(it2), type(it))
+                self.assertEqual(list(it2), list(expected[2:]))
+                self.assertEqual(list(it), list(expected[2:]))
+                it2 = pickle.loads(pickle.dumps(it, proto))
+                self.assertEqual(list(it2), [])
+
     def test_iteration_order(self):
         items = list('abcdef')
         d = ArrayDeque(items)
         self.assertEqual(list(d), items)
 
-    def test_multiplication_unsupported(self):
-        # Multiplication is not implemented (unlike list), so it should raise TypeError.
-        with self.assertRaises(TypeError):
-            _ = self.ad * 2
+    def test_reversed(self):
+        for size in (0, 1, 8, 9, 20):
+            d = ArrayDeque(range(-5, size))
+            for _ in range(5):
+                d.popleft()
+            with self.subTest(size=size):
+                it = reversed(d)
+                self.assertNotIsInstance(it, type(iter(d)))
+                self.assertEqual(it.__length_hint__(), size)
+                self.assertEqual(list(it), list(range(size))[::-1])
+                self.assertEqual(it.__length_hint__(), 0)
 
-    def test_delitem_unsupported(self):
-        # __delitem__ is not implemented.
+    def test_reversed_length_hint(self):
+        d = ArrayDeque('abcd')
+        it = reversed(d)
+        next(it)
+        self.assertEqual(it.__length_hint__(), 3)
+        d.pop()
+        d.pop()
+        d.pop()
+        self.assertEqual(it.__length_hint__(), 0)
+        with self.assertRaises(RuntimeError):
+            next(it)
+        self.assertEqual(list(it), [])
+
+    def test_reverse(self):
+        for size in (0, 1, 2, 7, 8, 9, 20):
+            for offset in (0, 5):
+                with self.subTest(size=size, offset=offset):
+                    d = ArrayDeque(range(-offset, size))
+                    for _ in range(offset):
+                        d.popleft()
+                    self.assertIsNone(d.reverse())
+                    self.assertEqual(list(d), list(range(size))[::-1])
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        d.reverse()
+        self.assertEqual(list(d), list(range(9))[::-1])
+
+    def test_multiplication(self):
+        self.assertEqual(list(self.ad * 2), ['a', 'b', 'c'] * 2)
+        self.assertEqual(list(2 * self.ad), ['a', 'b', 'c'] * 2)
         with self.assertRaises(TypeError):
+            _ = self.ad * 2.0
+
+    def test_delitem(self):
+        del self.ad[1]
+        self.assertEqual(list(self.ad), ['a', 'c'])
+        del self.ad[-1]
+        self.assertEqual(list(self.ad), ['a'])
+        with self.assertRaises(IndexError):
             del self.ad[1]
+        with self.assertRaises(IndexError):
+            del self.ad[-2]
 
-    def test_insert_unsupported(self):
-        # Insert is not implemented by ArrayDeque.
-        with self.assertRaises(AttributeError):
-            self.ad.insert(1, 'X')
+    def test_delitem_positions(self):
+        # Deleting near either end moves the shorter side.
+        for size in (1, 2, 8, 9, 33):
+            for offset in (0, 5):
+                for index in range(-size, size):
+                    with self.subTest(size=size, offset=offset, index=index):
+                        d = ArrayDeque(range(-offset, size))
+                        for _ in range(offset):
+                            d.popleft()
+                        ref = list(range(size))
+                        del d[index]
+                        del ref[index]
+                        self.assertEqual(list(d), ref)
+
+    def test_insert(self):
+        self.ad.insert(1, 'X')
+        self.assertEqual(list(self.ad), ['a', 'X', 'b', 'c'])
+        self.ad.insert(-1, 'Y')
+        self.assertEqual(list(self.ad), ['a', 'X', 'b', 'Y', 'c'])
+        self.ad.insert(100, 'Z')
+        self.ad.insert(-100, 'W')
+        self.assertEqual(list(self.ad), ['W', 'a', 'X', 'b', 'Y', 'c', 'Z'])
+
+    def test_insert_positions(self):
+        for size in (0, 1, 7, 8, 9, 16, 33):
+            for offset in (0, 5):
+                for index in range(-size - 2, size + 2):
+                    with self.subTest(size=size, offset=offset, index=index):
+                        d = ArrayDeque(range(-offset, size))
+                        for _ in range(offset):
+                            d.popleft()
+                        ref = deque(range(size))
+                        d.insert(index, 'x')
+                        ref.insert(index, 'x')
+                        self.assertEqual(list(d), list(ref))
+
+    def test_insert_maxlen(self):
+        d = ArrayDeque('ab', maxlen=3)
+        d.insert(1, 'x')
+        self.assertEqual(list(d), ['a', 'x', 'b'])
+        with self.assertRaises(IndexError):
+            d.insert(1, 'y')
+        self.assertEqual(list(d), ['a', 'x', 'b'])
+
+    def test_insert_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        d.insert(2, 'x')
+        del d[6]
+        self.assertEqual(list(d), [0, 1, 'x', 2, 3, 4, 6, 7, 8])
 
     def test_remove(self):
         # Remove the first appearance of a value.
@@ -274,6 +1706,196 @@ class TestArrayDequeComparisons(unittest.TestCase):
         with self.assertRaises(ValueError):
             d.remove('z')
 
+    def test_remove_positions(self):
+        for size in (1, 2, 8, 9, 33):
+            for value in range(size):
+                with self.subTest(size=size, value=value):
+                    d = ArrayDeque(range(size))
+                    ref = list(range(size))
+                    d.remove(value)
+                    ref.remove(value)
+                    self.assertEqual(list(d), ref)
+
+    def test_remove_mutating_comparison(self):
+        class Evil:
+            def __eq__(self, other):
+                d.clear()
+                return True
+
+        d = ArrayDeque([Evil(), 1, 2])
+        with self.assertRaises(IndexError):
+            d.remove(None)
+
+    def test_index(self):
+        items = list('abcabcab')
+        d = ArrayDeque(['x', 'x'] + items)
+        d.popleft()
+        d.popleft()
+        ref = deque(items)
+        bounds = [(), (1,), (3,), (-2,), (-100,), (2, 5), (1, -1), (0, 100),
+                  (5, 2), (2**100,), (-(2**100), 2**100)]
+        for value in 'abcz':
+            for args in bounds:
+                with self.subTest(value=value, args=args):
+                    try:
+                        expected = ref.index(value, *args)
+                    except ValueError:
+                        with self.assertRaises(ValueError):
+                            d.index(value, *args)
+                    else:
+                        self.assertEqual(d.index(value, *args), expected)
+
+    def test_rindex(self):
+        items = list('abcabcab')
+        d = ArrayDeque(items)
+        for value in 'abcz':
+            for start in range(-10, 10):
+                for stop in range(-10, 10):
+                    with self.subTest(value=value, start=start, stop=stop):
+                        window = items[start:stop]
+                        if value in window:
+                            offset = len(window) - 1 - window[::-1].index(value)
+                            expected = range(len(items))[start:stop][offset]
+                            self.assertEqual(d.rindex(value, start, stop), expected)
+                        else:
+                            with self.assertRaises(ValueError):
+                                d.rindex(value, start, stop)
+        self.assertEqual(d.rindex('a'), 6)
+
+    def test_index_errors(self):
+        d = ArrayDeque([1, 2, 3])
+        with self.assertRaises(TypeError):
+            d.index(1, 'a')
+        with self.assertRaises(TypeError):
+            d.rindex()
+
+        class Evil:
+            def __eq__(self, other):
+                d.clear()
+                return False
+
+        d.append(Evil())
+        with self.assertRaises(RuntimeError):
+            d.rindex(None)
+
+    def test_scan_mixed_types(self):
+        # count, index, rindex and membership must agree with list semantics
+        # for values that compare equal across types or not at all.
+        class Eq:
+            def __init__(self, value):
+                self.value = value
+
+            def __eq__(self, other):
+                return other == self.value
+
+            __hash__ = None
+
+        big = 2**80
+        nan = float('nan')
+        pool = [1, 1.0, True, 2, 2.5, '1', 'a', 'é', b'1', b'a', big, float(big),
+                nan, None, (1,), Eq(1), Eq('a'), 'a' * 20, b'a' * 20, -1]
+        needles = pool + [int('1'), 'a' * 20 + '', bytes(b'1'), 10**30, nan,
+                          float('nan'), object(), 'é'.upper().lower()]
+        rng = random.Random(5)
+        for size in (0, 1, 3, 4, 5, 8, 17, 40):
+            items = [rng.choice(pool) for _ in range(size)]
+            d = ArrayDeque([None] * 3 + items)
+            for _ in range(3):
+                d.popleft()
+            for needle in needles:
+                with self.subTest(size=size, needle=needle):
+                    self.assertEqual(d.count(needle), items.count(needle))
+                    self.assertEqual(needle in d, needle in items)
+                    if needle in items:
+                        self.assertEqual(d.index(needle), items.index(needle))
+                        last = len(items) - 1 - items[::-1].index(needle)
+                        self.assertEqual(d.rindex(needle), last)
+                    else:
+                        with self.assertRaises(ValueError):
+                            d.index(needle)
+
+    def test_scan_identity_positions(self):
+        # Exercise every position relative to the vectorized blocks.
+        needle = object()
+        for size in range(1, 20):
+            for pos in range(size):
+                items = [object() for _ in range(size)]
+                items[pos] = needle
+                for offset in (0, 7):
+                    d = ArrayDeque(range(offset))
+                    d.extend(items)
+                    for _ in range(offset):
+                        d.popleft()
+                    with self.subTest(size=size, pos=pos, offset=offset):
+                        self.assertEqual(d.index(needle), pos)
+                        self.assertEqual(d.rindex(needle), pos)
+                        self.assertEqual(d.count(needle), 1)
+                        self.assertIn(needle, d)
+                        d.remove(needle)
+                        self.assertNotIn(needle, d)
+
+    def test_scan_mutation(self):
+        class Evil:
+            def __eq__(self, other):
+                d.append(None)
+                return False
+
+        for method in ('count', 'index', 'rindex', '__contains__'):
+            d = ArrayDeque([1, Evil(), 2])
+            with self.subTest(method=method):
+                with self.assertRaises(RuntimeError):
+                    getattr(d, method)(3)
+
+    def test_remove_all(self):
+        d = ArrayDeque('abcbcab')
+        self.assertEqual(d.remove_all('b'), 3)
+        self.assertEqual(list(d), ['a', 'c', 'c', 'a'])
+        self.assertEqual(d.remove_all('z'), 0)
+        self.assertEqual(d.remove_all('a'), 2)
+        self.assertEqual(list(d), ['c', 'c'])
+        self.assertEqual(ArrayDeque().remove_all(1), 0)
+
+    def test_filter_inplace(self):
+        for size in (1, 8, 9, 100):
+            for offset in (0, 5):
+                for mod in (2, 3, 7, size + 1):
+                    for rem in (0, 1, size - 1):
+                        with self.subTest(size=size, offset=offset, mod=mod, rem=rem):
+                            d = ArrayDeque(range(-offset, size))
+                            for _ in range(offset):
+                                d.popleft()
+
+                            def keep(x, mod=mod, rem=rem):
+                                return x % mod != rem or x < rem
+
+                            expected = [x for x in range(size) if keep(x)]
+                            removed = d.filter_inplace(keep)
+                            self.assertEqual(removed, size - len(expected))
+                            self.assertEqual(list(d), expected)
+
+    def test_filter_inplace_errors(self):
+        d = ArrayDeque([1, 2, 0, 3])
+        with self.assertRaises(ZeroDivisionError):
+            d.filter_inplace(lambda x: 1 / x)
+        self.assertEqual(list(d), [1, 2, 0, 3])
+
+        def mutate(x):
+            d.append(x)
+            return False
+
+        with self.assertRaises(RuntimeError):
+            d.filter_inplace(mutate)
+        self.assertEqual(list(d), [1, 2, 0, 3, 1])
+
+    def test_remove_all_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item, item, item, 1] * 25)
+        self.assertEqual(d.remove_all(item), 75)
+        self.assertEqual(sys.getrefcount(item), before)
+        self.assertEqual(list(d), [1] * 25)
+        self.assertLess(d.capacity, 128)
+
     def test_count(self):
         d = ArrayDeque('abbccc')
         self.assertEqual(d.count('a'), 1)
@@ -307,6 +1929,63 @@ class TestArrayDequePickleCopy(unittest.TestCase):
         d.append('z')
         self.assertNotEqual(list(d), list(d2))
 
+    def test_copy_method(self):
+        d = ArrayDeque(range(100), maxlen=120, incremental=True)
+        d.rotate(30)
+        d.shrink_threshold = 0.1
+        for d2 in (d.copy(), copy.copy(d)):
+            self.assertIs(type(d2), ArrayDeque)
+            self.assertIsNot(d2, d)
+            self.assertEqual(list(d2), list(d))
+            self.assertEqual(d2.maxlen, 120)
+            self.assertEqual(d2.capacity, 128)
+            self.assertEqual(d2.shrink_threshold, 0.1)
+            self.assertTrue(d2.incremental)
+        self.assertEqual(list(ArrayDeque().copy()), [])
+
+    def test_copy_references(self):
+        item = object()
+        before = sys.getrefcount(item)
+        d = ArrayDeque([item] * 20)
+        d2 = d.copy()
+        self.assertEqual(sys.getrefcount(item), before + 40)
+        del d, d2
+        self.assertEqual(sys.getrefcount(item), before)
+
+    def test_copy_during_migration(self):
+        d = ArrayDeque(range(8), incremental=True)
+        d.append(8)
+        self.assertEqual(list(d.copy()), list(range(9)))
+
+    def test_deepcopy_maxlen(self):
+        d = ArrayDeque([[i] for i in range(20)], maxlen=20)
+        d2 = copy.deepcopy(d)
+        self.assertEqual(d2.maxlen, 20)
+        self.assertEqual(list(d2), list(d))
+        for a, b in zip(d, d2):
+            self.assertIsNot(a, b)
+
+    def test_deepcopy_recursive(self):
+        d = ArrayDeque()
+        d.append(d)
+        d.append([d])
+        d2 = copy.deepcopy(d)
+        self.assertIs(d2[0], d2)
+        self.assertIs(d2[1][0], d2)
+
+    def test_deepcopy_shared(self):
+        shared = []
+        d2 = copy.deepcopy(ArrayDeque([shared, shared]))
+        self.assertIs(d2[0], d2[1])
+        self.assertIsNot(d2[0], shared)
+
+    def test_copy_subclass(self):
+        d = CustomDeque('abc', maxlen=5)
+        for d2 in (d.copy(), copy.copy(d), copy.deepcopy(d)):
+            self.assertIs(type(d2), CustomDeque)
+            self.assertEqual(list(d2), list('abc'))
+            self.assertEqual(d2.maxlen, 5)
+
 
 # ---------------------------
 # Subclassing Testing
@@ -327,6 +2006,70 @@ class TestArrayDequeSubclass(unittest.TestCase):
         self.assertEqual(list(d2), list(d))
 
 
+# ---------------------------
+# Module State Testing
+# ---------------------------
+class TestArrayDequeModule(unittest.TestCase):
+    def test_types_per_module(self):
+        module = load_module()
+        self.assertIsNot(module.ArrayDeque, ArrayDeque)
+        d = module.ArrayDeque(range(20))
+        self.assertIs(type(d[2:5]), module.ArrayDeque)
+        self.assertIs(type(d + d), module.ArrayDeque)
+        self.assertEqual(list(reversed(d)), list(range(19, -1, -1)))
+        # Deques of both modules interoperate as plain sequences.
+        self.assertEqual(d, ArrayDeque(range(20)))
+        d.extend(ArrayDeque('ab'))
+        self.assertEqual(d[-2:], module.ArrayDeque('ab'))
+
+    def test_module_unload(self):
+        # Objects parked on the freelists are released with the module.
+        for _ in range(3):
+            module = load_module()
+            deques = [module.ArrayDeque(range(n)) for n in range(40)]
+            iterators = [iter(d) for d in deques]
+            del deques, iterators, module
+            gc.collect()
+
+    def test_immutable_types(self):
+        if sys.version_info >= (3, 10):
+            with self.assertRaises(TypeError):
+                ArrayDeque.append = None
+        with self.assertRaises(TypeError):
+            type(iter(ArrayDeque()))()
+        with self.assertRaises(TypeError):
+            type(reversed(ArrayDeque()))()
+
+    def test_subinterpreter(self):
+        # An interpreter with its own GIL only imports modules that declare
+        # per-interpreter GIL support.  Older versions share the main GIL.
+        if sys.version_info >= (3, 13):
+            name, args, kwargs = '_interpreters', ('isolated',), {}
+        elif sys.version_info >= (3, 12):
+            name, args, kwargs = '_xxsubinterpreters', (), {'isolated': True}
+        else:
+            self.skipTest('requires isolated subinterpreters (Python 3.12+)')
+        try:
+            interpreters = importlib.import_module(name)
+        except ImportError:
+            self.skipTest(f'requires {name}')
+        code = (
+            'import sys\n'
+            f'sys.path[:] = {sys.path!r}\n'
+            'from arraydeque import ArrayDeque\n'
+            'd = ArrayDeque(range(100))\n'
+            'd.rotate(10)\n'
+            'assert list(d) == list(range(90, 100)) + list(range(90))\n'
+        )
+        interp = interpreters.create(*args, **kwargs)
+        try:
+            # Python 3.12 raises on failure; 3.13 returns a description
+            failure = interpreters.run_string(interp, code)
+        finally:
+            interpreters.destroy(interp)
+        self.assertIsNone(failure)
+
+
 # ---------------------------
 # Main: Run all tests
 # ---------------------------